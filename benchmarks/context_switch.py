@@ -0,0 +1,75 @@
+"""Latency of switching between contexts of a share group with and without the implicit flush.
+
+Usage::
+
+    python benchmarks/context_switch.py [backend]
+
+The backend defaults to egl. Two share groups of two contexts are created, one with
+``release_behavior='flush'`` and one with ``release_behavior='none'``. Each switch leaves
+a small buffer update pending in the context that stops being current, the driver
+submits it on release unless the release behavior is none.
+Times are per round trip through both contexts.
+"""
+import ctypes
+import sys
+import timeit
+
+import glcontext
+
+GL_ARRAY_BUFFER = 0x8892
+GL_DYNAMIC_DRAW = 0x88E8
+
+
+def measure(label, stmt, number=20000, repeat=5):
+    best = min(timeit.repeat(stmt, number=number, repeat=repeat))
+    print('{:<24} {:8.1f} us'.format(label, best / number * 1e6))
+
+
+def create_pair(name, release_behavior):
+    if name == 'egl':
+        from glcontext import egl
+        return egl.create_share_group(2, glversion=330, release_behavior=release_behavior)
+    backend = glcontext.get_backend_by_name(name)
+    return backend(mode='standalone', glversion=330, release_behavior=release_behavior), backend(mode='standalone', glversion=330, release_behavior=release_behavior)
+
+
+def switch_benchmark(ctx1, ctx2):
+    load = ctx1.load
+    gen_buffers = ctypes.CFUNCTYPE(None, ctypes.c_int, ctypes.POINTER(ctypes.c_uint))(load('glGenBuffers'))
+    bind_buffer = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint)(load('glBindBuffer'))
+    buffer_data = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_ssize_t, ctypes.c_void_p, ctypes.c_uint)(load('glBufferData'))
+    buffer_sub_data = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_ssize_t, ctypes.c_ssize_t, ctypes.c_void_p)(load('glBufferSubData'))
+    data = (ctypes.c_ubyte * 64)()
+
+    # every context gets its own bound buffer, the binding is not shared
+    for ctx in (ctx1, ctx2):
+        with ctx:
+            buffer = ctypes.c_uint()
+            gen_buffers(1, ctypes.byref(buffer))
+            bind_buffer(GL_ARRAY_BUFFER, buffer.value)
+            buffer_data(GL_ARRAY_BUFFER, 64, None, GL_DYNAMIC_DRAW)
+
+    def switch():
+        with ctx1:
+            buffer_sub_data(GL_ARRAY_BUFFER, 0, 64, data)
+        with ctx2:
+            buffer_sub_data(GL_ARRAY_BUFFER, 0, 64, data)
+
+    return switch
+
+
+def main():
+    name = sys.argv[1] if len(sys.argv) > 1 else 'egl'
+
+    for release_behavior in ('flush', 'none'):
+        ctx1, ctx2 = create_pair(name, release_behavior)
+        if ctx1.release_behavior != release_behavior:
+            print('{:<24} not supported by the driver'.format('release ' + release_behavior))
+        else:
+            measure('release ' + release_behavior, switch_benchmark(ctx1, ctx2))
+        ctx1.release()
+        ctx2.release()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,56 @@
+"""Per-call overhead of the hot GLContext methods.
+
+Usage::
+
+    python benchmarks/method_overhead.py [backend]
+
+The backend defaults to egl. Two standalone contexts are created.
+The reenter benchmark enters a context that is already current, it measures
+the call overhead without the driver. The switch benchmark alternates
+between the two contexts in nested with blocks.
+"""
+import sys
+import timeit
+
+import glcontext
+
+
+def measure(label, stmt, number=200000, repeat=5):
+    best = min(timeit.repeat(stmt, number=number, repeat=repeat))
+    print('{:<24} {:8.1f} ns'.format(label, best / number * 1e9))
+
+
+def main():
+    name = sys.argv[1] if len(sys.argv) > 1 else 'egl'
+    backend = glcontext.get_backend_by_name(name)
+    ctx1 = backend(mode='standalone', glversion=330)
+    ctx2 = backend(mode='standalone', glversion=330)
+
+    def load():
+        ctx1.load('glEnable')
+
+    def enter_exit():
+        with ctx1:
+            pass
+
+    def reenter():
+        with ctx1:
+            pass
+
+    def switch():
+        with ctx1:
+            with ctx2:
+                pass
+
+    measure('load', load)
+    measure('enter + exit', enter_exit)
+    with ctx1:
+        measure('reenter', reenter)
+    measure('nested switch', switch)
+
+    ctx1.release()
+    ctx2.release()
+
+
+if __name__ == '__main__':
+    main()
@@ -2,6 +2,15 @@ import os
 
 __version__ = '2.3.7'
 
+_executor = None
+_prewarmed = []
+
+
+def get_include():
+    """Directory of ``glcontext.hpp``, the header declaring the C level API
+    exported as ``c_api`` capsules by the x11 and egl backends."""
+    return os.path.dirname(os.path.abspath(__file__))
+
 
 def default_backend():
     """Get default backend based on the detected platform.
@@ -48,9 +57,85 @@ def get_backend_by_name(name: str):
     if name == 'egl':
         return _egl()
 
+    if name == 'surfaceless':
+        return _surfaceless()
+
     raise ValueError("Cannot find supported backend: '{}'".format(name))
 
 
+def create_context_async(backend=None, **kwargs):
+    """Create a standalone context on a background thread.
+
+    The backends release the GIL while the driver is initialized,
+    so other Python threads keep running meanwhile.
+    The context is unbound before the future completes,
+    it can be made current on any thread with a with block.
+
+    Example::
+
+        future = glcontext.create_context_async('egl', glversion=330)
+        ...
+        ctx = future.result()  # or: await asyncio.wrap_future(future)
+        with ctx:
+            ...
+
+    Args:
+        backend: A backend name, a backend object or None for the default backend
+        kwargs: Arguments passed to the backend
+
+    Returns:
+        A concurrent.futures.Future resolving to the context
+    """
+    backend = _resolve_backend(backend)
+    kwargs.setdefault('mode', 'standalone')
+    return _get_executor().submit(_create_unbound, backend, kwargs)
+
+
+def prewarm(backend=None, **kwargs):
+    """Initialize a backend on a background thread.
+
+    A standalone context is created and kept unbound until the process exits.
+    It keeps the libraries loaded and for egl the device display initialized,
+    so the first context of the application is created without that latency.
+    Setting the ``GLCONTEXT_PREWARM`` environment variable to a backend name
+    prewarms that backend when glcontext is imported.
+
+    Returns:
+        A concurrent.futures.Future resolving to the prewarmed context
+    """
+    future = create_context_async(backend, **kwargs)
+    future.add_done_callback(_keep_prewarmed)
+    return future
+
+
+def _resolve_backend(backend):
+    if backend is None or backend == 'default':
+        return default_backend()
+    if isinstance(backend, str):
+        return get_backend_by_name(backend)
+    return backend
+
+
+def _get_executor():
+    global _executor
+    if _executor is None:
+        from concurrent.futures import ThreadPoolExecutor
+        _executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix='glcontext')
+    return _executor
+
+
+def _create_unbound(backend, kwargs):
+    ctx = backend(**kwargs)
+    # creating a context makes it current on the worker thread
+    ctx.__exit__(None, None, None)
+    return ctx
+
+
+def _keep_prewarmed(future):
+    if not future.cancelled() and future.exception() is None:
+        _prewarmed.append(future.result())
+
+
 def _wgl():
     """Create wgl backend"""
     from glcontext import wgl
@@ -74,19 +159,12 @@ def _wgl():
 def _x11():
     """Create x11 backend"""
     from glcontext import x11
-    from ctypes.util import find_library
 
     def create(*args, **kwargs):
-        if not kwargs.get('libgl'):
-            kwargs['libgl'] = find_library('GL') 
-
-        if not kwargs.get('libx11'):
-            kwargs['libx11'] = find_library("X11")
-
         _apply_env_var(kwargs, 'glversion', 'GLCONTEXT_GLVERSION', arg_type=int)
         _apply_env_var(kwargs, 'libgl', 'GLCONTEXT_LINUX_LIBGL')
         _apply_env_var(kwargs, 'libx11', 'GLCONTEXT_LINUX_LIBX11')
-        kwargs = _strip_kwargs(kwargs, ['glversion', 'mode', 'libgl', 'libx11'])
+        kwargs = _strip_kwargs(kwargs, ['glversion', 'mode', 'libgl', 'libx11', 'config', 'no_error', 'release_behavior'])
         return x11.create_context(**kwargs)
 
     return create
@@ -104,24 +182,35 @@ def _darwin():
 
 def _egl():
     from glcontext import egl
-    from ctypes.util import find_library
 
     def create(*args, **kwargs):
-        if not kwargs.get('libgl'):
-            kwargs['libgl'] = find_library('GL') 
-        if not kwargs.get('libegl'):
-            kwargs['libegl'] = find_library('EGL') 
-
-        _apply_env_var(kwargs, 'device_index', 'GLCONTEXT_DEVICE_INDEX', arg_type=int)
+        _apply_env_var(kwargs, 'device_index', 'GLCONTEXT_DEVICE_INDEX', arg_type=_device_index)
         _apply_env_var(kwargs, 'glversion', 'GLCONTEXT_GLVERSION', arg_type=int)
         _apply_env_var(kwargs, 'libgl', 'GLCONTEXT_LINUX_LIBGL')
         _apply_env_var(kwargs, 'libegl', 'GLCONTEXT_LINUX_LIBEGL')
-        kwargs = _strip_kwargs(kwargs, ['glversion', 'mode', 'libgl', 'libegl', 'device_index'])
+        kwargs = _strip_kwargs(kwargs, ['glversion', 'mode', 'libgl', 'libegl', 'device_index', 'share', 'placement', 'config', 'no_error', 'release_behavior'])
         return egl.create_context(**kwargs)
 
     return create
 
 
+def _surfaceless():
+    """Create egl backend creating standalone contexts on the surfaceless platform"""
+    create_egl = _egl()
+
+    def create(*args, **kwargs):
+        if kwargs.get('mode', 'standalone') == 'standalone':
+            kwargs['mode'] = 'surfaceless'
+        return create_egl(*args, **kwargs)
+
+    return create
+
+
+def _device_index(value):
+    """A device index or ``'auto'`` to let the egl backend place the context"""
+    return value if value == 'auto' else int(value)
+
+
 def _strip_kwargs(kwargs: dict, supported_args: list):
     """Strips away unwanted keyword arguments.
 
@@ -141,3 +230,6 @@ def _apply_env_var(kwargs, arg_name, env_name, arg_type=str):
     if value:
         kwargs[arg_name] = arg_type(value)
 
+
+if os.environ.get('GLCONTEXT_PREWARM'):
+    prewarm(os.environ['GLCONTEXT_PREWARM'])
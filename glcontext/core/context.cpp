@@ -0,0 +1,338 @@
+#include "context.hpp"
+#include "glcontext.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <unordered_set>
+
+namespace glcontext {
+
+// Errors are formatted on the thread that failed and read back by the caller on the same thread.
+thread_local char error_message[256];
+
+const char * last_error() {
+    return error_message;
+}
+
+void set_error(const char * format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error_message, sizeof(error_message), format, args);
+    va_end(args);
+}
+
+ShareGroup * retain_share_group(ShareGroup * group) {
+    if (!group) {
+        group = new ShareGroup();
+        group->refcount = 1;
+        group->num_pending = 0;
+        return group;
+    }
+    std::lock_guard<std::mutex> guard(group->lock);
+    group->refcount += 1;
+    return group;
+}
+
+void release_share_group(ShareGroup * group) {
+    bool last;
+    {
+        std::lock_guard<std::mutex> guard(group->lock);
+        group->refcount -= 1;
+        last = !group->refcount;
+    }
+    if (last) {
+        delete group;
+    }
+}
+
+void add_share_group_member(ShareGroup * group, void * native) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    group->members.push_back(native);
+}
+
+void remove_share_group_member(ShareGroup * group, void * native) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    std::vector<void *>::iterator it = std::find(group->members.begin(), group->members.end(), native);
+    if (it != group->members.end()) {
+        group->members.erase(it);
+    }
+    // the driver frees the objects of a share group with its last context
+    if (group->members.empty()) {
+        group->pending.clear();
+        group->num_pending = 0;
+    }
+}
+
+void delete_shared_object(ShareGroup * group, void * current_native, DeleteProc proc, void * object) {
+    std::lock_guard<std::mutex> guard(group->lock);
+    if (group->members.empty()) {
+        return;
+    }
+    if (current_native && std::find(group->members.begin(), group->members.end(), current_native) != group->members.end()) {
+        proc(object);
+        return;
+    }
+    group->pending.push_back(std::make_pair(proc, object));
+    group->num_pending += 1;
+}
+
+void run_pending_deletions(ShareGroup * group) {
+    if (!group || !group->num_pending) {
+        return;
+    }
+    std::vector<std::pair<DeleteProc, void *> > pending;
+    {
+        std::lock_guard<std::mutex> guard(group->lock);
+        pending.swap(group->pending);
+        group->num_pending = 0;
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+        pending[i].first(pending[i].second);
+    }
+}
+
+// A context is current on at most one thread, a set is enough.
+std::mutex bound_lock;
+std::unordered_set<void *> bound_contexts;
+
+void track_binding(void * previous, void * next) {
+    if (previous == next) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(bound_lock);
+    if (previous) {
+        bound_contexts.erase(previous);
+    }
+    if (next) {
+        bound_contexts.insert(next);
+    }
+}
+
+bool bound_on_any_thread(void * native) {
+    std::lock_guard<std::mutex> guard(bound_lock);
+    return bound_contexts.count(native) != 0;
+}
+
+Context::~Context() {
+    if (group) {
+        release_share_group(group);
+    }
+}
+
+namespace {
+
+typedef struct __GLsync * GLsync;
+
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+
+typedef GLsync (* m_glFenceSyncProc)(unsigned int, unsigned int);
+typedef unsigned int (* m_glClientWaitSyncProc)(GLsync, unsigned int, unsigned long long);
+typedef void (* m_glWaitSyncProc)(GLsync, unsigned int, unsigned long long);
+typedef void (* m_glDeleteSyncProc)(GLsync);
+typedef void (* m_glFlushProc)();
+
+class GLFence : public Fence {
+  public:
+    Context * context;
+    GLsync sync;
+
+    m_glClientWaitSyncProc m_glClientWaitSync;
+    m_glWaitSyncProc m_glWaitSync;
+    m_glDeleteSyncProc m_glDeleteSync;
+
+    ~GLFence();
+
+    int client_wait(double timeout);
+    bool server_wait();
+    bool needs_context() { return true; }
+};
+
+GLFence::~GLFence() {
+    // sync objects are deleted with a context of their share group current. The producer may be current
+    // on another thread, so it is never made current here, the deletion waits for its next enter() instead.
+    delete_shared_object(context->group, context->current_native(), (DeleteProc)m_glDeleteSync, sync);
+}
+
+int GLFence::client_wait(double timeout) {
+    unsigned long long nanoseconds = timeout < 0.0 ? GL_TIMEOUT_IGNORED : (unsigned long long)(timeout * 1e9);
+    unsigned int status = m_glClientWaitSync(sync, 0, nanoseconds);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+        return 1;
+    }
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return 0;
+    }
+    set_error("glClientWaitSync failed (0x%x)", status);
+    return -1;
+}
+
+bool GLFence::server_wait() {
+    m_glWaitSync(sync, 0, GL_TIMEOUT_IGNORED);
+    return true;
+}
+
+}
+
+Fence * create_gl_fence(Context * context) {
+    m_glFenceSyncProc m_glFenceSync = (m_glFenceSyncProc)context->load("glFenceSync");
+    m_glFlushProc m_glFlush = (m_glFlushProc)context->load("glFlush");
+
+    m_glClientWaitSyncProc m_glClientWaitSync = (m_glClientWaitSyncProc)context->load("glClientWaitSync");
+    m_glWaitSyncProc m_glWaitSync = (m_glWaitSyncProc)context->load("glWaitSync");
+    m_glDeleteSyncProc m_glDeleteSync = (m_glDeleteSyncProc)context->load("glDeleteSync");
+
+    if (!m_glFenceSync || !m_glFlush || !m_glClientWaitSync || !m_glWaitSync || !m_glDeleteSync) {
+        set_error("sync objects are not supported");
+        return NULL;
+    }
+
+    if (!context->enter()) {
+        return NULL;
+    }
+
+    GLsync sync = m_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (sync) {
+        m_glFlush();
+    }
+    context->exit();
+
+    if (!sync) {
+        set_error("glFenceSync failed");
+        return NULL;
+    }
+
+    GLFence * res = new GLFence();
+    res->context = context;
+    res->sync = sync;
+    res->m_glClientWaitSync = m_glClientWaitSync;
+    res->m_glWaitSync = m_glWaitSync;
+    res->m_glDeleteSync = m_glDeleteSync;
+    return res;
+}
+
+FramePacer::FramePacer(Context * context, int max_frames) : context(context), max_frames(max_frames) {
+}
+
+FramePacer::~FramePacer() {
+    while (fences.size()) {
+        delete fences.front();
+        fences.pop_front();
+    }
+}
+
+// OpenGL sync objects are waited on and deleted with the context of the pacer current, the caller may have none.
+int FramePacer::wait_oldest(double timeout) {
+    Fence * fence = fences.front();
+    bool bind = fence->needs_context();
+    if (bind && !context->enter()) {
+        return -1;
+    }
+    int res = fence->client_wait(timeout);
+    if (res == 1) {
+        delete fence;
+        fences.pop_front();
+    }
+    if (bind) {
+        context->exit();
+    }
+    return res;
+}
+
+bool FramePacer::begin_frame() {
+    while ((int)fences.size() >= max_frames) {
+        if (wait_oldest(-1.0) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FramePacer::end_frame() {
+    Fence * fence = context->fence();
+    if (!fence) {
+        return false;
+    }
+    fences.push_back(fence);
+    return true;
+}
+
+int FramePacer::frames_in_flight() {
+    // frames whose fence signaled are dropped without waiting
+    while (fences.size()) {
+        if (wait_oldest(0.0) != 1) {
+            break;
+        }
+    }
+    return (int)fences.size();
+}
+
+}
+
+int glcontext_enter(glcontext_context * context) {
+    return ((glcontext::Context *)context)->enter();
+}
+
+int glcontext_exit(glcontext_context * context) {
+    return ((glcontext::Context *)context)->exit();
+}
+
+void * glcontext_load(glcontext_context * context, const char * name) {
+    return ((glcontext::Context *)context)->load(name);
+}
+
+void glcontext_release(glcontext_context * context) {
+    ((glcontext::Context *)context)->release();
+}
+
+void glcontext_destroy(glcontext_context * context) {
+    delete (glcontext::Context *)context;
+}
+
+int glcontext_no_error(glcontext_context * context) {
+    return ((glcontext::Context *)context)->no_error();
+}
+
+int glcontext_release_behavior(glcontext_context * context) {
+    return ((glcontext::Context *)context)->release_behavior();
+}
+
+glcontext_fence * glcontext_create_fence(glcontext_context * context) {
+    return (glcontext_fence *)((glcontext::Context *)context)->fence();
+}
+
+int glcontext_fence_client_wait(glcontext_fence * fence, double timeout) {
+    return ((glcontext::Fence *)fence)->client_wait(timeout);
+}
+
+int glcontext_fence_server_wait(glcontext_fence * fence) {
+    return ((glcontext::Fence *)fence)->server_wait();
+}
+
+void glcontext_fence_destroy(glcontext_fence * fence) {
+    delete (glcontext::Fence *)fence;
+}
+
+glcontext_frame_pacer * glcontext_create_frame_pacer(glcontext_context * context, int max_frames) {
+    return (glcontext_frame_pacer *)new glcontext::FramePacer((glcontext::Context *)context, max_frames);
+}
+
+int glcontext_begin_frame(glcontext_frame_pacer * pacer) {
+    return ((glcontext::FramePacer *)pacer)->begin_frame();
+}
+
+int glcontext_end_frame(glcontext_frame_pacer * pacer) {
+    return ((glcontext::FramePacer *)pacer)->end_frame();
+}
+
+void glcontext_frame_pacer_destroy(glcontext_frame_pacer * pacer) {
+    delete (glcontext::FramePacer *)pacer;
+}
+
+const char * glcontext_last_error(void) {
+    return glcontext::last_error();
+}
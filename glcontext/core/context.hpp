@@ -0,0 +1,201 @@
+#pragma once
+
+// Python-free core of the x11 and egl backends.
+// The extension modules are thin wrappers over this library, native programs can link it directly.
+
+#include "glcontext.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace glcontext {
+
+// A fence inserted into the command stream of a context, signaled once the GPU executed the commands before it.
+// Fences are used to hand objects over between contexts of the same share group without calling glFinish.
+class Fence {
+  public:
+    virtual ~Fence() {}
+
+    // Block the calling thread until the fence is signaled or timeout seconds passed, a negative timeout waits forever.
+    // Return 1 when signaled, 0 on timeout and -1 on failure.
+    virtual int client_wait(double timeout) = 0;
+
+    // Make the context current on the calling thread wait for the fence on the GPU, the caller does not block.
+    virtual bool server_wait() = 0;
+
+    // Whether waiting on and deleting the fence requires a context of its share group to be current.
+    virtual bool needs_context() { return false; }
+};
+
+typedef void (* DeleteProc)(void *);
+
+// The native contexts sharing their objects. Objects that can only be deleted with a context of the group current,
+// like OpenGL sync objects, are queued when they are dropped on a thread without one. The next context of the group
+// made current through enter() deletes them. Pooled contexts keep their group.
+struct ShareGroup {
+    std::mutex lock;
+    int refcount;
+    std::vector<void *> members;
+    std::vector<std::pair<DeleteProc, void *> > pending;
+    std::atomic<int> num_pending;
+};
+
+// NULL creates a new group, the caller owns a reference either way.
+ShareGroup * retain_share_group(ShareGroup * group);
+void release_share_group(ShareGroup * group);
+
+// Native contexts are members from their creation until they are destroyed.
+void add_share_group_member(ShareGroup * group, void * native);
+void remove_share_group_member(ShareGroup * group, void * native);
+
+// Delete the object right away when a member is current on the calling thread, queue the deletion otherwise.
+// Objects of a group without members were freed with its last context.
+void delete_shared_object(ShareGroup * group, void * current_native, DeleteProc proc, void * object);
+
+// Run the queued deletions, a member of the group must be current on the calling thread.
+void run_pending_deletions(ShareGroup * group);
+
+// Native contexts the backends made current on some thread and did not unbind since.
+// Pools must not hand out a context that may still be current on another thread.
+// Contexts unbound by other libraries stay marked, they are destroyed instead of pooled.
+void track_binding(void * previous, void * next);
+bool bound_on_any_thread(void * native);
+
+// An OpenGL context created by one of the backends.
+// Bindings are tracked per thread, enter() and exit() can be nested like with blocks.
+class Context {
+  public:
+    Context() : group(NULL) {}
+    virtual ~Context();
+
+    // Set by the backend when the context is created, released with the object.
+    ShareGroup * group;
+
+    // The native context current on the calling thread through any library, NULL when there is none.
+    virtual void * current_native() = 0;
+
+    // Make the context current on the calling thread and remember the previous binding.
+    // On failure the binding is kept, nothing is remembered and exit() must not be called.
+    virtual bool enter() = 0;
+
+    // Restore the binding that was current before the matching enter(), unbind when there is none.
+    virtual bool exit() = 0;
+
+    // Whether enter() or exit() would call into the driver on the calling thread.
+    // Bindings use these to skip releasing the interpreter lock for calls that return right away.
+    virtual bool enter_changes_binding() = 0;
+    virtual bool exit_changes_binding() = 0;
+
+    // The address of an OpenGL function or NULL if it is not implemented.
+    virtual void * load(const char * name) = 0;
+
+    // Destroy the context or return it to the pool. The object must still be deleted.
+    // Deleting a context that was never released keeps its libraries loaded.
+    virtual void release() = 0;
+
+    virtual bool standalone() = 0;
+
+    // Whether the context was created without error checking, false when KHR_no_error was not requested or not supported.
+    virtual bool no_error() = 0;
+
+    // GLCONTEXT_RELEASE_NONE if switching away from the context skips the implicit flush (KHR_context_flush_control).
+    // Commands are then only submitted by an explicit flush, a fence or a later binding of the same context.
+    virtual int release_behavior() = 0;
+
+    // Insert a fence after the commands submitted so far and flush them, return NULL on failure.
+    // The context must not be current on another thread.
+    virtual Fence * fence() = 0;
+};
+
+// Bounds the number of frames submitted to a context but not completed by the GPU.
+// Headless render loops have no swap chain to pace them, the pacer keeps a ring of fences instead.
+class FramePacer {
+  public:
+    FramePacer(Context * context, int max_frames);
+    ~FramePacer();
+
+    // Wait until fewer than max_frames frames are in flight, return false on failure.
+    bool begin_frame();
+
+    // Insert a fence after the commands of the frame, return false on failure.
+    bool end_frame();
+
+    int frames_in_flight();
+
+  private:
+    // Wait for the oldest frame and drop it once signaled, return the result of client_wait().
+    int wait_oldest(double timeout);
+
+    Context * context;
+    int max_frames;
+    std::deque<Fence *> fences;
+};
+
+struct PoolStats {
+    int size;
+    int max_size;
+    long long hits;
+    long long misses;
+    long long evictions;
+};
+
+// The message of the last error on the calling thread.
+const char * last_error();
+void set_error(const char * format, ...);
+
+// A fence backed by an OpenGL sync object, loaded through the context that creates it.
+// Waiting on it requires a context of the same share group to be current on the calling thread.
+Fence * create_gl_fence(Context * context);
+
+// An EGL device as reported by EGL_EXT_device_query, queried once per loaded library.
+// Strings the driver does not report are empty, cuda_device is -1 for devices without EGL_NV_device_cuda.
+struct DeviceInfo {
+    int index;
+    bool software;
+    std::string drm_device;
+    std::string drm_render_node;
+    std::string vendor;
+    std::string renderer;
+    std::string driver;
+    int cuda_device;
+    std::vector<std::string> extensions;
+    std::vector<std::string> platforms;
+};
+
+// Negative device indices let the egl backend place standalone contexts on one of the devices.
+// Placement uses the live standalone contexts per device, counted by the backend.
+// DEVICE_SURFACELESS selects the surfaceless platform, it is also used when the devices cannot be enumerated.
+enum {
+    DEVICE_ROUND_ROBIN = -1,
+    DEVICE_LEAST_CONTEXTS = -2,
+    DEVICE_PREFER_HARDWARE = -3,
+    DEVICE_SURFACELESS = -4,
+};
+
+// Shared with the C interface, NULL selects the defaults. Contexts with a custom config are not pooled.
+typedef glcontext_options ContextOptions;
+
+// The library names may be NULL to use the defaults located once per process.
+// A standalone egl context created with share uses the display and config of that context and shares its objects.
+// Mode "surfaceless" creates a standalone egl context on the surfaceless platform.
+Context * create_egl_context(const char * mode, const char * libgl, const char * libegl, int glversion, int device_index, Context * share, const ContextOptions * options);
+// Create count standalone contexts sharing their objects, the first one is made current.
+bool create_egl_share_group(int count, const char * libgl, const char * libegl, int glversion, int device_index, const ContextOptions * options, Context ** contexts);
+// Whether fences of the egl context are EGL sync objects, any thread can wait on those without a current context.
+bool egl_fence_sync_supported(Context * context);
+// The devices of the libraries, the library names may be NULL to use the defaults.
+bool egl_devices(const char * libgl, const char * libegl, std::vector<DeviceInfo> & devices);
+// Fill counts with the live standalone contexts per device and return the number of devices.
+int egl_live_contexts(int * counts, int max_devices);
+void configure_egl_pool(int max_size, double max_idle);
+PoolStats egl_pool_stats();
+
+Context * create_x11_context(const char * mode, const char * libgl, const char * libx11, int glversion, const ContextOptions * options);
+void configure_x11_pool(int max_size, double max_idle);
+PoolStats x11_pool_stats();
+
+}
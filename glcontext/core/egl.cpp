@@ -0,0 +1,1431 @@
+#include "context.hpp"
+#include "glcontext.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+namespace glcontext {
+
+namespace {
+
+struct Display;
+
+typedef unsigned int EGLenum;
+typedef int EGLint;
+typedef unsigned int EGLBoolean;
+typedef Display * EGLNativeDisplayType;
+typedef void * EGLConfig;
+typedef void * EGLSurface;
+typedef void * EGLContext;
+typedef void * EGLDeviceEXT;
+typedef void * EGLDisplay;
+typedef void * EGLSyncKHR;
+typedef unsigned long long EGLTimeKHR;
+
+
+#define EGL_DEFAULT_DISPLAY 0
+#define EGL_NO_CONTEXT 0
+#define EGL_NO_SURFACE 0
+#define EGL_NO_DISPLAY 0
+#define EGL_PBUFFER_BIT 0x0001
+#define EGL_WINDOW_BIT 0x0004
+#define EGL_RENDERABLE_TYPE 0x3040
+#define EGL_NONE 0x3038
+#define EGL_OPENGL_BIT 0x0008
+#define EGL_BLUE_SIZE 0x3022
+#define EGL_DEPTH_SIZE 0x3025
+#define EGL_RED_SIZE 0x3024
+#define EGL_GREEN_SIZE 0x3023
+#define EGL_SURFACE_TYPE 0x3033
+#define EGL_OPENGL_API 0x30A2
+#define EGL_WIDTH 0x3057
+#define EGL_HEIGHT 0x3056
+#define EGL_SUCCESS 0x3000
+#define EGL_CONTEXT_MAJOR_VERSION 0x3098
+#define EGL_CONTEXT_MINOR_VERSION 0x30FB
+#define EGL_CONTEXT_OPENGL_PROFILE_MASK 0x30FD
+#define EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT 0x00000001
+#define EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE 0x31B1
+#define EGL_CONTEXT_OPENGL_NO_ERROR_KHR 0x31B3
+#define EGL_CONTEXT_RELEASE_BEHAVIOR_KHR 0x2097
+#define EGL_CONTEXT_RELEASE_BEHAVIOR_NONE_KHR 0
+#define EGL_PLATFORM_DEVICE_EXT 0x313F
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#define EGL_PLATFORM_WAYLAND_EXT 0x31D8
+#define EGL_PLATFORM_X11_EXT 0x31D5
+#define EGL_DRAW 0x3059
+#define EGL_READ 0x305A
+#define EGL_EXTENSIONS 0x3055
+#define EGL_BUFFER_SIZE 0x3020
+#define EGL_STENCIL_SIZE 0x3026
+#define EGL_SAMPLES 0x3031
+#define EGL_NO_CONFIG_KHR 0
+#define EGL_VENDOR 0x3053
+#define EGL_DRM_DEVICE_FILE_EXT 0x3233
+#define EGL_DRM_RENDER_NODE_FILE_EXT 0x3377
+#define EGL_RENDERER_EXT 0x335F
+#define EGL_DRIVER_NAME_EXT 0x335E
+#define EGL_CUDA_DEVICE_NV 0x323A
+#define EGL_SYNC_FENCE_KHR 0x30F9
+#define EGL_TIMEOUT_EXPIRED_KHR 0x30F5
+#define EGL_CONDITION_SATISFIED_KHR 0x30F6
+#define EGL_FOREVER_KHR 0xFFFFFFFFFFFFFFFFull
+#define EGL_NO_SYNC_KHR 0
+
+typedef EGLint (* m_eglGetErrorProc)();
+typedef EGLDisplay (* m_eglGetDisplayProc)(EGLNativeDisplayType);
+typedef EGLBoolean (* m_eglInitializeProc)(EGLDisplay, EGLint *, EGLint *);
+typedef EGLBoolean (* m_eglTerminateProc)(EGLDisplay);
+typedef EGLBoolean (* m_eglChooseConfigProc)(EGLDisplay, const EGLint *, EGLConfig *, EGLint, EGLint *);
+typedef EGLBoolean (* m_eglGetConfigAttribProc)(EGLDisplay, EGLConfig, EGLint, EGLint *);
+typedef EGLBoolean (* m_eglBindAPIProc)(EGLenum);
+typedef EGLContext (* m_eglCreateContextProc)(EGLDisplay, EGLConfig, EGLContext, const EGLint *);
+typedef EGLBoolean (* m_eglDestroyContextProc)(EGLDisplay, EGLContext);
+typedef EGLBoolean (* m_eglMakeCurrentProc)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
+typedef void (* (* m_eglGetProcAddressProc)(const char *))();
+typedef EGLBoolean (* m_eglQueryDevicesEXTProc)(EGLint, EGLDeviceEXT *, EGLint *);
+typedef const char * (* m_eglQueryDeviceStringEXTProc)(EGLDeviceEXT, EGLint);
+typedef EGLBoolean (* m_eglQueryDeviceAttribEXTProc)(EGLDeviceEXT, EGLint, intptr_t *);
+typedef const char * (* m_eglQueryStringProc)(EGLDisplay, EGLint);
+typedef EGLDisplay (* m_eglGetPlatformDisplayEXTProc) (EGLenum, void *, const EGLint *);
+typedef EGLContext (* m_eglGetCurrentContextProc) (void);	 
+typedef EGLSurface (* m_eglGetCurrentSurfaceProc ) (EGLint readdraw);
+typedef EGLDisplay (* m_eglGetCurrentDisplayProc )(void);	
+typedef EGLSyncKHR (* m_eglCreateSyncKHRProc)(EGLDisplay, EGLenum, const EGLint *);
+typedef EGLBoolean (* m_eglDestroySyncKHRProc)(EGLDisplay, EGLSyncKHR);
+typedef EGLint (* m_eglClientWaitSyncKHRProc)(EGLDisplay, EGLSyncKHR, EGLint, EGLTimeKHR);
+typedef EGLint (* m_eglWaitSyncKHRProc)(EGLDisplay, EGLSyncKHR, EGLint);
+
+// Loaded libraries are shared by every context created with the same libGL and libEGL.
+// The resolved EGL functions and the OpenGL function cache live as long as the libraries are loaded.
+// The last context closes the handles, but driver code is never unmapped (see load_library).
+typedef std::unordered_map<std::string, void *> SymbolCache;
+
+// Initialized displays are shared by every standalone context created on the same device.
+// The display of the surfaceless platform is kept under DEVICE_SURFACELESS.
+// eglTerminate is called once the last context on the device is released by every library using it.
+// Selected configs are cached per display, keyed by the requested attributes.
+struct DeviceDisplay {
+    int refcount;
+    int device_index;
+    EGLDisplay dpy;
+    std::map<std::vector<EGLint>, EGLConfig> configs;
+};
+
+struct Library {
+    int refcount;
+    std::pair<std::string, std::string> key;
+
+    void * libgl;
+    void * libegl;
+    SymbolCache procs;
+    std::mutex procs_lock;
+
+    bool devices_queried;
+    std::vector<EGLDeviceEXT> devices;
+    std::vector<DeviceInfo> device_info;
+    std::map<int, DeviceDisplay *> displays;
+
+    // standalone contexts holding a display of the device, used to place contexts created with a negative device index
+    // the counts are per process, placement starts at a device picked by the process id to spread worker processes
+    std::vector<int> live_contexts;
+    int first_device;
+    int next_device;
+
+    m_eglGetErrorProc m_eglGetError;
+    m_eglGetDisplayProc m_eglGetDisplay;
+    m_eglInitializeProc m_eglInitialize;
+    m_eglTerminateProc m_eglTerminate;
+    m_eglChooseConfigProc m_eglChooseConfig;
+    m_eglGetConfigAttribProc m_eglGetConfigAttrib;
+    m_eglBindAPIProc m_eglBindAPI;
+    m_eglCreateContextProc m_eglCreateContext;
+    m_eglDestroyContextProc m_eglDestroyContext;
+    m_eglMakeCurrentProc m_eglMakeCurrent;
+    m_eglGetProcAddressProc m_eglGetProcAddress;
+    m_eglQueryDevicesEXTProc m_eglQueryDevicesEXT;
+    m_eglQueryDeviceStringEXTProc m_eglQueryDeviceStringEXT;
+    m_eglQueryDeviceAttribEXTProc m_eglQueryDeviceAttribEXT;
+    m_eglQueryStringProc m_eglQueryString;
+    m_eglGetPlatformDisplayEXTProc m_eglGetPlatformDisplayEXT;
+    m_eglGetCurrentContextProc m_eglGetCurrentContext;
+    m_eglGetCurrentSurfaceProc m_eglGetCurrentSurface;
+    m_eglGetCurrentDisplayProc m_eglGetCurrentDisplay;
+
+    // EGL_KHR_fence_sync and EGL_KHR_wait_sync, NULL when the implementation does not provide them
+    m_eglCreateSyncKHRProc m_eglCreateSyncKHR;
+    m_eglDestroySyncKHRProc m_eglDestroySyncKHR;
+    m_eglClientWaitSyncKHRProc m_eglClientWaitSyncKHR;
+    m_eglWaitSyncKHRProc m_eglWaitSyncKHR;
+};
+
+std::map<std::pair<std::string, std::string>, Library *> libraries;
+
+// Guards the library registry, the device displays and the context pool.
+// Callers from Python release the GIL before any of the functions below take it.
+std::mutex registry_lock;
+
+// eglGetPlatformDisplayEXT returns the same EGLDisplay for a device whatever libGL was loaded with.
+// Libraries sharing a libEGL handle count their users of a display here, the last one terminates it.
+std::map<std::pair<void *, EGLDisplay>, int> initialized_displays;
+
+class EGLBackendContext : public Context {
+  public:
+    Library * lib;
+    DeviceDisplay * display;
+    EGLContext ctx;
+    EGLDisplay dpy;
+    EGLConfig cfg;
+    EGLSurface wnd;
+
+    int is_standalone;
+    int is_shared;
+    int custom_config;
+    int is_no_error;
+    int release_mode;
+    int requested_no_error;
+    int requested_release_mode;
+    int glversion;
+
+    EGLBackendContext() : lib(NULL), display(NULL), ctx(EGL_NO_CONTEXT), dpy(EGL_NO_DISPLAY), cfg(NULL), wnd(EGL_NO_SURFACE), is_standalone(false), is_shared(false), custom_config(false), is_no_error(false), release_mode(GLCONTEXT_RELEASE_FLUSH), requested_no_error(false), requested_release_mode(GLCONTEXT_RELEASE_FLUSH), glversion(0) {}
+    ~EGLBackendContext();
+
+    bool enter();
+    bool exit();
+    bool enter_changes_binding();
+    bool exit_changes_binding();
+    void * load(const char * name);
+    void release();
+    bool standalone();
+    bool no_error();
+    int release_behavior();
+    Fence * fence();
+    void * current_native();
+};
+
+// EGL sync objects belong to the display, they can be waited on from any thread without a current context.
+// A fence keeps its library and display referenced, so it may outlive the context that created it.
+class EGLFence : public Fence {
+  public:
+    Library * lib;
+    DeviceDisplay * display;
+    EGLDisplay dpy;
+    EGLSyncKHR sync;
+
+    ~EGLFence();
+
+    int client_wait(double timeout);
+    bool server_wait();
+};
+
+// Released standalone contexts are kept for reuse when pooling is enabled with configure_egl_pool().
+// A pooled context keeps its library and display references and is only handed out for the same
+// library, device, OpenGL version, error checking and release behavior it was created with.
+// Requests are matched on the options asked for, the driver may have fallen back to a regular context.
+struct PooledContext {
+    Library * lib;
+    DeviceDisplay * display;
+    EGLConfig cfg;
+    EGLContext ctx;
+    ShareGroup * group;
+    int no_error;
+    int release_mode;
+    int requested_no_error;
+    int requested_release_mode;
+    int glversion;
+    std::chrono::steady_clock::time_point released;
+};
+
+struct ContextPool {
+    int max_size;
+    double max_idle;
+    long long hits;
+    long long misses;
+    long long evictions;
+    std::deque<PooledContext> entries;
+};
+
+ContextPool pool;
+
+bool load_library_procs(Library * lib) {
+    lib->m_eglGetError = (m_eglGetErrorProc)dlsym(lib->libegl, "eglGetError");
+    if (!lib->m_eglGetError) {
+        set_error("eglGetError not found");
+        return false;
+    }
+
+    lib->m_eglGetDisplay = (m_eglGetDisplayProc)dlsym(lib->libegl, "eglGetDisplay");
+    if (!lib->m_eglGetDisplay) {
+        set_error("eglGetDisplay not found");
+        return false;
+    }
+
+    lib->m_eglInitialize = (m_eglInitializeProc)dlsym(lib->libegl, "eglInitialize");
+    if (!lib->m_eglInitialize) {
+        set_error("eglInitialize not found");
+        return false;
+    }
+
+    lib->m_eglTerminate = (m_eglTerminateProc)dlsym(lib->libegl, "eglTerminate");
+    if (!lib->m_eglTerminate) {
+        set_error("eglTerminate not found");
+        return false;
+    }
+
+    lib->m_eglChooseConfig = (m_eglChooseConfigProc)dlsym(lib->libegl, "eglChooseConfig");
+    if (!lib->m_eglChooseConfig) {
+        set_error("eglChooseConfig not found");
+        return false;
+    }
+
+    lib->m_eglGetConfigAttrib = (m_eglGetConfigAttribProc)dlsym(lib->libegl, "eglGetConfigAttrib");
+    if (!lib->m_eglGetConfigAttrib) {
+        set_error("eglGetConfigAttrib not found");
+        return false;
+    }
+
+    lib->m_eglBindAPI = (m_eglBindAPIProc)dlsym(lib->libegl, "eglBindAPI");
+    if (!lib->m_eglBindAPI) {
+        set_error("eglBindAPI not found");
+        return false;
+    }
+
+    lib->m_eglCreateContext = (m_eglCreateContextProc)dlsym(lib->libegl, "eglCreateContext");
+    if (!lib->m_eglCreateContext) {
+        set_error("eglCreateContext not found");
+        return false;
+    }
+
+    lib->m_eglDestroyContext = (m_eglDestroyContextProc)dlsym(lib->libegl, "eglDestroyContext");
+    if (!lib->m_eglDestroyContext) {
+        set_error("eglDestroyContext not found");
+        return false;
+    }
+
+    lib->m_eglMakeCurrent = (m_eglMakeCurrentProc)dlsym(lib->libegl, "eglMakeCurrent");
+    if (!lib->m_eglMakeCurrent) {
+        set_error("eglMakeCurrent not found");
+        return false;
+    }
+
+    lib->m_eglGetProcAddress = (m_eglGetProcAddressProc)dlsym(lib->libegl, "eglGetProcAddress");
+    if (!lib->m_eglGetProcAddress) {
+        set_error("eglGetProcAddress not found");
+        return false;
+    }
+
+    // device enumeration is optional, standalone contexts fall back to the surfaceless platform without it
+    lib->m_eglQueryDevicesEXT = (m_eglQueryDevicesEXTProc)lib->m_eglGetProcAddress("eglQueryDevicesEXT");
+
+    // EGL 1.5 eglGetPlatformDisplay only differs in the attribute type, no attributes are passed
+    lib->m_eglGetPlatformDisplayEXT = (m_eglGetPlatformDisplayEXTProc)lib->m_eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!lib->m_eglGetPlatformDisplayEXT) {
+        lib->m_eglGetPlatformDisplayEXT = (m_eglGetPlatformDisplayEXTProc)lib->m_eglGetProcAddress("eglGetPlatformDisplay");
+    }
+    if (!lib->m_eglGetPlatformDisplayEXT) {
+        set_error("eglGetPlatformDisplayEXT not found");
+        return false;
+    }
+
+    lib->m_eglGetCurrentDisplay = (m_eglGetCurrentDisplayProc)lib->m_eglGetProcAddress("eglGetCurrentDisplay");
+    if (!lib->m_eglGetCurrentDisplay) {
+        set_error("eglGetCurrentDisplay not found");
+        return false;
+    }
+
+    lib->m_eglGetCurrentContext = (m_eglGetCurrentContextProc)lib->m_eglGetProcAddress("eglGetCurrentContext");
+    if (!lib->m_eglGetCurrentContext) {
+        set_error("eglGetCurrentContext not found");
+        return false;
+    }
+
+    lib->m_eglGetCurrentSurface = (m_eglGetCurrentSurfaceProc)lib->m_eglGetProcAddress("eglGetCurrentSurface");
+    if (!lib->m_eglGetCurrentSurface) {
+        set_error("eglGetCurrentSurfaceProc not found");
+        return false;
+    }
+
+    lib->m_eglQueryDeviceStringEXT = (m_eglQueryDeviceStringEXTProc)lib->m_eglGetProcAddress("eglQueryDeviceStringEXT");
+    lib->m_eglQueryDeviceAttribEXT = (m_eglQueryDeviceAttribEXTProc)lib->m_eglGetProcAddress("eglQueryDeviceAttribEXT");
+    lib->m_eglQueryString = (m_eglQueryStringProc)dlsym(lib->libegl, "eglQueryString");
+
+    lib->m_eglCreateSyncKHR = (m_eglCreateSyncKHRProc)lib->m_eglGetProcAddress("eglCreateSyncKHR");
+    lib->m_eglDestroySyncKHR = (m_eglDestroySyncKHRProc)lib->m_eglGetProcAddress("eglDestroySyncKHR");
+    lib->m_eglClientWaitSyncKHR = (m_eglClientWaitSyncKHRProc)lib->m_eglGetProcAddress("eglClientWaitSyncKHR");
+    lib->m_eglWaitSyncKHR = (m_eglWaitSyncKHRProc)lib->m_eglGetProcAddress("eglWaitSyncKHR");
+    return true;
+}
+
+void free_library(Library * lib) {
+    if (lib->libegl) {
+        dlclose(lib->libegl);
+    }
+    if (lib->libgl) {
+        dlclose(lib->libgl);
+    }
+    delete lib;
+}
+
+Library * load_library(const char * libgl, const char * libegl) {
+    std::pair<std::string, std::string> key(libgl, libegl);
+    std::map<std::pair<std::string, std::string>, Library *>::iterator it = libraries.find(key);
+    if (it != libraries.end()) {
+        it->second->refcount += 1;
+        return it->second;
+    }
+
+    Library * lib = new Library();
+    lib->refcount = 1;
+    lib->key = key;
+
+    // Drivers register thread exit handlers, their code must stay mapped after the last context is released.
+    lib->libgl = dlopen(libgl, RTLD_LAZY | RTLD_NODELETE);
+    if (!lib->libgl) {
+        set_error("%s not loaded", libgl);
+        free_library(lib);
+        return NULL;
+    }
+
+    lib->libegl = dlopen(libegl, RTLD_LAZY | RTLD_NODELETE);
+    if (!lib->libegl) {
+        set_error("%s not loaded", libegl);
+        free_library(lib);
+        return NULL;
+    }
+
+    if (!load_library_procs(lib)) {
+        free_library(lib);
+        return NULL;
+    }
+
+    libraries[key] = lib;
+    return lib;
+}
+
+void release_library(Library * lib) {
+    lib->refcount -= 1;
+    if (!lib->refcount) {
+        libraries.erase(lib->key);
+        free_library(lib);
+    }
+}
+
+std::vector<std::string> split_extensions(const char * extensions) {
+    std::vector<std::string> res;
+    while (extensions && *extensions) {
+        const char * end = strchr(extensions, ' ');
+        if (!end) {
+            end = extensions + strlen(extensions);
+        }
+        if (end != extensions) {
+            res.push_back(std::string(extensions, end));
+        }
+        extensions = *end ? end + 1 : end;
+    }
+    return res;
+}
+
+bool has_extension(const std::vector<std::string> & extensions, const char * name) {
+    for (size_t i = 0; i < extensions.size(); ++i) {
+        if (extensions[i] == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string query_device_string(Library * lib, EGLDeviceEXT device, EGLint name) {
+    const char * value = lib->m_eglQueryDeviceStringEXT(device, name);
+    return value ? value : "";
+}
+
+void query_device_info(Library * lib, int index, DeviceInfo & info) {
+    EGLDeviceEXT device = lib->devices[index];
+    info.index = index;
+    info.software = false;
+    info.cuda_device = -1;
+    if (!lib->m_eglQueryDeviceStringEXT) {
+        return;
+    }
+
+    info.extensions = split_extensions(lib->m_eglQueryDeviceStringEXT(device, EGL_EXTENSIONS));
+    info.software = has_extension(info.extensions, "EGL_MESA_device_software");
+    if (has_extension(info.extensions, "EGL_EXT_device_drm")) {
+        info.drm_device = query_device_string(lib, device, EGL_DRM_DEVICE_FILE_EXT);
+    }
+    if (has_extension(info.extensions, "EGL_EXT_device_drm_render_node")) {
+        info.drm_render_node = query_device_string(lib, device, EGL_DRM_RENDER_NODE_FILE_EXT);
+    }
+    if (has_extension(info.extensions, "EGL_EXT_device_persistent_id")) {
+        info.vendor = query_device_string(lib, device, EGL_VENDOR);
+        info.renderer = query_device_string(lib, device, EGL_RENDERER_EXT);
+        info.driver = query_device_string(lib, device, EGL_DRIVER_NAME_EXT);
+    }
+
+    intptr_t cuda_device;
+    if (lib->m_eglQueryDeviceAttribEXT && has_extension(info.extensions, "EGL_NV_device_cuda")) {
+        if (lib->m_eglQueryDeviceAttribEXT(device, EGL_CUDA_DEVICE_NV, &cuda_device)) {
+            info.cuda_device = (int)cuda_device;
+        }
+    }
+
+    // every device works on the device platform, gbm additionally needs a DRM node to open
+    std::vector<std::string> client_extensions;
+    if (lib->m_eglQueryString) {
+        client_extensions = split_extensions(lib->m_eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS));
+    }
+    info.platforms.push_back("device");
+    bool gbm = has_extension(client_extensions, "EGL_KHR_platform_gbm") || has_extension(client_extensions, "EGL_MESA_platform_gbm");
+    if (gbm && (info.drm_device.size() || info.drm_render_node.size())) {
+        info.platforms.push_back("gbm");
+    }
+}
+
+bool has_client_extension(Library * lib, const char * name) {
+    const char * extensions = lib->m_eglQueryString ? lib->m_eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS) : NULL;
+    return has_extension(split_extensions(extensions), name);
+}
+
+bool query_devices(Library * lib) {
+    if (lib->devices_queried) {
+        return true;
+    }
+
+    if (!lib->m_eglQueryDevicesEXT) {
+        set_error("eglQueryDevicesEXT not found");
+        return false;
+    }
+
+    EGLint num_devices;
+    if (!lib->m_eglQueryDevicesEXT(0, NULL, &num_devices)) {
+        set_error("eglQueryDevicesEXT failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    lib->devices.resize(num_devices);
+    if (!lib->m_eglQueryDevicesEXT(num_devices, lib->devices.data(), &num_devices)) {
+        set_error("eglQueryDevicesEXT failed (0x%x)", lib->m_eglGetError());
+        lib->devices.clear();
+        return false;
+    }
+
+    lib->devices.resize(num_devices);
+    lib->live_contexts.resize(num_devices);
+    lib->first_device = num_devices ? (int)(getpid() % num_devices) : 0;
+    lib->next_device = lib->first_device;
+    lib->device_info.resize(num_devices);
+    for (int i = 0; i < num_devices; ++i) {
+        query_device_info(lib, i, lib->device_info[i]);
+    }
+    lib->devices_queried = true;
+    return true;
+}
+
+// Resolve a negative device index to one of the devices, the caller holds the registry lock.
+// The device platform comes first, the default device and placements fall back to the surfaceless
+// platform when the devices cannot be enumerated.
+int place_context(Library * lib, int device_index) {
+    if (device_index == DEVICE_SURFACELESS) {
+        return device_index;
+    }
+
+    if (!query_devices(lib) || !lib->devices.size()) {
+        if (device_index <= 0 && has_client_extension(lib, "EGL_MESA_platform_surfaceless")) {
+            return DEVICE_SURFACELESS;
+        }
+        return device_index;
+    }
+
+    if (device_index >= 0) {
+        return device_index;
+    }
+
+    int num_devices = (int)lib->devices.size();
+    if (device_index == DEVICE_ROUND_ROBIN) {
+        int index = lib->next_device % num_devices;
+        lib->next_device = index + 1;
+        return index;
+    }
+
+    // hardware devices are preferred as long as there is one, software rasterizers are used otherwise
+    bool hardware_only = false;
+    if (device_index == DEVICE_PREFER_HARDWARE) {
+        for (int i = 0; i < num_devices; ++i) {
+            hardware_only = hardware_only || !lib->device_info[i].software;
+        }
+    }
+
+    // ties go to the first device of the process
+    int best = -1;
+    for (int k = 0; k < num_devices; ++k) {
+        int i = (lib->first_device + k) % num_devices;
+        if (hardware_only && lib->device_info[i].software) {
+            continue;
+        }
+        if (best < 0 || lib->live_contexts[i] < lib->live_contexts[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void track_context(Library * lib, DeviceDisplay * display, int delta) {
+    // contexts on the surfaceless platform are not placed, they are not counted
+    if (display->device_index >= 0) {
+        lib->live_contexts[display->device_index] += delta;
+    }
+}
+
+DeviceDisplay * acquire_display(Library * lib, int device_index) {
+    std::map<int, DeviceDisplay *>::iterator it = lib->displays.find(device_index);
+    if (it != lib->displays.end()) {
+        it->second->refcount += 1;
+        return it->second;
+    }
+
+    EGLDisplay dpy;
+    if (device_index == DEVICE_SURFACELESS) {
+        if (!has_client_extension(lib, "EGL_MESA_platform_surfaceless")) {
+            set_error("EGL_MESA_platform_surfaceless is not supported");
+            return NULL;
+        }
+        dpy = lib->m_eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+    } else {
+        if (!query_devices(lib)) {
+            return NULL;
+        }
+
+        int num_devices = (int)lib->devices.size();
+        if (device_index < 0 || device_index >= num_devices) {
+            set_error("requested device index %d, but found %d devices", device_index, num_devices);
+            return NULL;
+        }
+
+        dpy = lib->m_eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, lib->devices[device_index], 0);
+    }
+
+    if (dpy == EGL_NO_DISPLAY) {
+        set_error("eglGetPlatformDisplayEXT failed (0x%x)", lib->m_eglGetError());
+        return NULL;
+    }
+
+    int & users = initialized_displays[std::make_pair(lib->libegl, dpy)];
+    EGLint major, minor;
+    if (!users && !lib->m_eglInitialize(dpy, &major, &minor)) {
+        set_error("eglInitialize failed (0x%x)", lib->m_eglGetError());
+        initialized_displays.erase(std::make_pair(lib->libegl, dpy));
+        return NULL;
+    }
+    users += 1;
+
+    DeviceDisplay * display = new DeviceDisplay();
+    display->refcount = 1;
+    display->device_index = device_index;
+    display->dpy = dpy;
+    lib->displays[device_index] = display;
+    return display;
+}
+
+void release_display(Library * lib, DeviceDisplay * display) {
+    display->refcount -= 1;
+    if (!display->refcount) {
+        lib->displays.erase(display->device_index);
+        std::pair<void *, EGLDisplay> key = std::make_pair(lib->libegl, display->dpy);
+        if (!--initialized_displays[key]) {
+            initialized_displays.erase(key);
+            lib->m_eglTerminate(display->dpy);
+        }
+        delete display;
+    }
+}
+
+void destroy_pooled_context(PooledContext & entry) {
+    remove_share_group_member(entry.group, entry.ctx);
+    release_share_group(entry.group);
+    entry.lib->m_eglDestroyContext(entry.display->dpy, entry.ctx);
+    release_display(entry.lib, entry.display);
+    release_library(entry.lib);
+}
+
+void evict_pooled_contexts(int max_size) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (pool.entries.size()) {
+        PooledContext & entry = pool.entries.front();
+        std::chrono::duration<double> idle = now - entry.released;
+        if ((int)pool.entries.size() <= max_size && (pool.max_idle <= 0.0 || idle.count() < pool.max_idle)) {
+            break;
+        }
+        destroy_pooled_context(entry);
+        pool.entries.pop_front();
+        pool.evictions += 1;
+    }
+}
+
+bool acquire_pooled_context(EGLBackendContext * res, int device_index, int glversion) {
+    if (!pool.max_size) {
+        return false;
+    }
+    evict_pooled_contexts(pool.max_size);
+    for (std::deque<PooledContext>::reverse_iterator it = pool.entries.rbegin(); it != pool.entries.rend(); ++it) {
+        if (it->lib == res->lib && it->display->device_index == device_index && it->glversion == glversion && it->requested_no_error == res->requested_no_error && it->requested_release_mode == res->requested_release_mode) {
+            res->display = it->display;
+            res->dpy = it->display->dpy;
+            res->cfg = it->cfg;
+            res->ctx = it->ctx;
+            res->group = it->group;
+            res->is_no_error = it->no_error;
+            res->release_mode = it->release_mode;
+            res->glversion = it->glversion;
+            release_library(it->lib);
+            pool.entries.erase(--it.base());
+            pool.hits += 1;
+            return true;
+        }
+    }
+    pool.misses += 1;
+    return false;
+}
+
+bool recycle_context(EGLBackendContext * self) {
+    // contexts in a share group or with a custom config are not handed out to unrelated callers
+    if (!pool.max_size || !self->display || self->is_shared || self->custom_config) {
+        return false;
+    }
+    evict_pooled_contexts(pool.max_size - 1);
+    PooledContext entry;
+    entry.lib = self->lib;
+    entry.display = self->display;
+    entry.cfg = self->cfg;
+    entry.ctx = self->ctx;
+    entry.group = retain_share_group(self->group);
+    entry.no_error = self->is_no_error;
+    entry.release_mode = self->release_mode;
+    entry.requested_no_error = self->requested_no_error;
+    entry.requested_release_mode = self->requested_release_mode;
+    entry.glversion = self->glversion;
+    entry.released = std::chrono::steady_clock::now();
+    self->lib->refcount += 1;
+    pool.entries.push_back(entry);
+    return true;
+}
+
+// The binding made current through this module on the calling thread and the bindings to restore
+// when leaving nested enter() calls. eglGetCurrentContext is a cheap client side query, it is used to
+// detect bindings changed by other libraries.
+struct Binding {
+    EGLDisplay dpy;
+    EGLSurface draw;
+    EGLSurface read;
+    EGLContext ctx;
+};
+
+thread_local Binding current_binding;
+thread_local std::vector<Binding> binding_stack;
+
+Binding & get_current(Library * lib) {
+    Binding & current = current_binding;
+    EGLContext ctx = lib->m_eglGetCurrentContext();
+    if (ctx != current.ctx) {
+        current.dpy = lib->m_eglGetCurrentDisplay();
+        current.draw = lib->m_eglGetCurrentSurface(EGL_DRAW);
+        current.read = lib->m_eglGetCurrentSurface(EGL_READ);
+        current.ctx = ctx;
+    }
+    return current;
+}
+
+bool is_bound(const Binding & current, EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx) {
+    return current.ctx == ctx && (!ctx || (current.dpy == dpy && current.draw == draw && current.read == read));
+}
+
+bool is_current(Library * lib, EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx) {
+    return is_bound(get_current(lib), dpy, draw, read, ctx);
+}
+
+// The current binding is passed in by callers that already queried it.
+EGLBoolean switch_binding(Library * lib, Binding & current, EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx) {
+    if (is_bound(current, dpy, draw, read, ctx)) {
+        return true;
+    }
+    if (!lib->m_eglMakeCurrent(dpy, draw, read, ctx)) {
+        current.ctx = NULL;
+        return false;
+    }
+    track_binding(current.ctx, ctx);
+    current.dpy = dpy;
+    current.draw = draw;
+    current.read = read;
+    current.ctx = ctx;
+    return true;
+}
+
+EGLBoolean make_current(Library * lib, EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx) {
+    return switch_binding(lib, get_current(lib), dpy, draw, read, ctx);
+}
+
+// Library names tried in order when the caller does not pass one in.
+// dlopen searches the same paths as ldconfig, the first name that loads is remembered for the process.
+const char * libgl_names[] = {"libGL.so.1", "libGL.so", NULL};
+const char * libegl_names[] = {"libEGL.so.1", "libEGL.so", NULL};
+const char * default_libgl;
+const char * default_libegl;
+
+const char * find_library(const char ** names, const char ** found) {
+    if (*found) {
+        return *found;
+    }
+    int index = 0;
+    while (names[index + 1]) {
+        void * handle = dlopen(names[index], RTLD_LAZY);
+        if (handle) {
+            dlclose(handle);
+            break;
+        }
+        index += 1;
+    }
+    // the last name is used as is, so a failure is reported when the library is loaded
+    *found = names[index];
+    return *found;
+}
+
+bool has_display_extension(Library * lib, EGLDisplay dpy, const char * name) {
+    const char * extensions = lib->m_eglQueryString ? lib->m_eglQueryString(dpy, EGL_EXTENSIONS) : NULL;
+    return has_extension(split_extensions(extensions), name);
+}
+
+// The matching config with the smallest default framebuffer, multisampled buffers count once per sample.
+EGLConfig cheapest_config(Library * lib, EGLDisplay dpy, const std::vector<EGLConfig> & configs) {
+    EGLConfig best = configs[0];
+    long long best_cost = -1;
+    for (size_t i = 0; i < configs.size(); ++i) {
+        EGLint buffer_size = 0, depth_size = 0, stencil_size = 0, samples = 0;
+        lib->m_eglGetConfigAttrib(dpy, configs[i], EGL_BUFFER_SIZE, &buffer_size);
+        lib->m_eglGetConfigAttrib(dpy, configs[i], EGL_DEPTH_SIZE, &depth_size);
+        lib->m_eglGetConfigAttrib(dpy, configs[i], EGL_STENCIL_SIZE, &stencil_size);
+        lib->m_eglGetConfigAttrib(dpy, configs[i], EGL_SAMPLES, &samples);
+        long long cost = (long long)(buffer_size + depth_size + stencil_size) * (samples > 1 ? samples : 1);
+        if (best_cost < 0 || cost < best_cost) {
+            best = configs[i];
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+// The default config keeps the first result of eglChooseConfig, explicit attributes select the cheapest match.
+bool choose_config(Library * lib, DeviceDisplay * display, const ContextOptions * options, EGLConfig * cfg) {
+    if (options && options->no_config) {
+        if (!has_display_extension(lib, display->dpy, "EGL_KHR_no_config_context")) {
+            set_error("EGL_KHR_no_config_context is not supported");
+            return false;
+        }
+        *cfg = EGL_NO_CONFIG_KHR;
+        return true;
+    }
+
+    bool custom = options && options->config_attribs;
+    std::vector<EGLint> attribs;
+    if (custom) {
+        EGLint defaults[] = {EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT};
+        attribs.assign(defaults, defaults + 4);
+        for (const int * attrib = options->config_attribs; *attrib != EGL_NONE; attrib += 2) {
+            attribs.push_back(attrib[0]);
+            attribs.push_back(attrib[1]);
+        }
+    } else {
+        // contexts on the surfaceless platform never get a pbuffer, any config will do
+        EGLint defaults[] = {
+            EGL_SURFACE_TYPE, display->device_index == DEVICE_SURFACELESS ? 0 : EGL_PBUFFER_BIT,
+            EGL_BLUE_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_RED_SIZE, 8,
+            EGL_DEPTH_SIZE, 8,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        };
+        attribs.assign(defaults, defaults + 12);
+    }
+    attribs.push_back(EGL_NONE);
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    std::map<std::vector<EGLint>, EGLConfig>::iterator it = display->configs.find(attribs);
+    if (it != display->configs.end()) {
+        *cfg = it->second;
+        return true;
+    }
+
+    EGLint num_configs = 0;
+    if (!lib->m_eglChooseConfig(display->dpy, attribs.data(), NULL, 0, &num_configs)) {
+        set_error("eglChooseConfig failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    std::vector<EGLConfig> configs(num_configs ? num_configs : 1);
+    if (!lib->m_eglChooseConfig(display->dpy, attribs.data(), configs.data(), (EGLint)configs.size(), &num_configs)) {
+        set_error("eglChooseConfig failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    if (!num_configs) {
+        // the default config keeps the former behavior of creating the context with whatever was returned
+        if (custom) {
+            set_error("no config matches the requested attributes");
+            return false;
+        }
+        configs[0] = NULL;
+        num_configs = 1;
+    }
+
+    configs.resize(num_configs);
+    *cfg = custom ? cheapest_config(lib, display->dpy, configs) : configs[0];
+    display->configs[attribs] = *cfg;
+    return true;
+}
+
+std::vector<EGLint> context_attribs(int glversion, bool no_error, int release_mode) {
+    EGLint version[] = {
+        EGL_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
+        EGL_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        // EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, 1,
+    };
+    std::vector<EGLint> attribs(version, version + 6);
+    if (no_error) {
+        attribs.push_back(EGL_CONTEXT_OPENGL_NO_ERROR_KHR);
+        attribs.push_back(1);
+    }
+    if (release_mode == GLCONTEXT_RELEASE_NONE) {
+        attribs.push_back(EGL_CONTEXT_RELEASE_BEHAVIOR_KHR);
+        attribs.push_back(EGL_CONTEXT_RELEASE_BEHAVIOR_NONE_KHR);
+    }
+    attribs.push_back(EGL_NONE);
+    return attribs;
+}
+
+bool create_standalone_context(EGLBackendContext * res, int device_index, int glversion, EGLBackendContext * share, const ContextOptions * options) {
+    Library * lib = res->lib;
+
+    res->is_standalone = true;
+    res->wnd = EGL_NO_SURFACE;
+    res->glversion = glversion;
+    res->custom_config = options && (options->config_attribs || options->no_config);
+    res->is_no_error = options && options->no_error;
+    res->release_mode = options ? options->release_behavior : GLCONTEXT_RELEASE_FLUSH;
+    res->requested_no_error = res->is_no_error;
+    res->requested_release_mode = res->release_mode;
+
+    // contexts sharing objects with another standalone context use its display and config,
+    // contexts of a share group must agree on error checking so they follow the share context
+    if (share) {
+        if (share->lib != lib || !share->display || !share->ctx) {
+            set_error("share must be a standalone context created with the same libraries");
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(registry_lock);
+        share->display->refcount += 1;
+        track_context(lib, share->display, 1);
+        res->display = share->display;
+        res->cfg = share->cfg;
+        res->is_no_error = share->is_no_error;
+        res->is_shared = true;
+        share->is_shared = true;
+    }
+
+    bool pooled = false;
+    if (!share) {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        device_index = place_context(lib, device_index);
+        pooled = !res->custom_config && acquire_pooled_context(res, device_index, glversion);
+        if (!pooled) {
+            res->display = acquire_display(lib, device_index);
+        }
+        if (res->display) {
+            track_context(lib, res->display, 1);
+        }
+    }
+
+    if (pooled) {
+        return true;
+    }
+
+    if (!res->display) {
+        return false;
+    }
+
+    res->dpy = res->display->dpy;
+
+    if (!share && !choose_config(lib, res->display, options, &res->cfg)) {
+        return false;
+    }
+
+    // without the extension a regular context is created, no_error() reports the outcome
+    if (!share && res->is_no_error && !has_display_extension(lib, res->dpy, "EGL_KHR_create_context_no_error")) {
+        res->is_no_error = false;
+    }
+
+    if (res->release_mode == GLCONTEXT_RELEASE_NONE && !has_display_extension(lib, res->dpy, "EGL_KHR_context_flush_control")) {
+        res->release_mode = GLCONTEXT_RELEASE_FLUSH;
+    }
+
+    if (!lib->m_eglBindAPI(EGL_OPENGL_API)) {
+        set_error("eglBindAPI failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    std::vector<EGLint> ctxattribs = context_attribs(glversion, res->is_no_error, res->release_mode);
+
+    res->ctx = lib->m_eglCreateContext(res->dpy, res->cfg, share ? share->ctx : EGL_NO_CONTEXT, ctxattribs.data());
+    if (!res->ctx) {
+        set_error("eglCreateContext failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    res->group = retain_share_group(share ? share->group : NULL);
+    add_share_group_member(res->group, res->ctx);
+
+    return true;
+}
+
+bool create_shared_context(EGLBackendContext * res, int glversion) {
+    Library * lib = res->lib;
+
+    res->is_standalone = false;
+    res->glversion = glversion;
+
+    EGLContext ctx_share = lib->m_eglGetCurrentContext();
+    if (!ctx_share) {
+        set_error("(share) eglGetCurrentContext: cannot detect OpenGL context");
+        return false;
+    }
+
+    res->wnd = lib->m_eglGetCurrentSurface(EGL_DRAW);
+    if (!res->wnd) {
+        set_error("(share) m_eglGetCurrentSurface failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    res->dpy = lib->m_eglGetCurrentDisplay();
+    if (res->dpy == EGL_NO_DISPLAY) {
+        set_error("eglGetCurrentDisplay failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+        EGL_BLUE_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_RED_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLint num_configs = 0;
+    if (!lib->m_eglChooseConfig(res->dpy, config_attribs, &res->cfg, 1, &num_configs)) {
+        set_error("eglChooseConfig failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    if (!lib->m_eglBindAPI(EGL_OPENGL_API)) {
+        set_error("eglBindAPI failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    std::vector<EGLint> ctxattribs = context_attribs(glversion, false, GLCONTEXT_RELEASE_FLUSH);
+
+    res->ctx = lib->m_eglCreateContext(res->dpy, res->cfg, ctx_share, ctxattribs.data());
+    if (!res->ctx) {
+        set_error("eglCreateContext failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+
+    // the current context the objects are shared with was created elsewhere, it is not a member
+    res->group = retain_share_group(NULL);
+    add_share_group_member(res->group, res->ctx);
+
+    if (!make_current(lib, res->dpy, res->wnd, res->wnd, res->ctx)) {
+        set_error("eglMakeCurrent failed (0x%x)", lib->m_eglGetError());
+        remove_share_group_member(res->group, res->ctx);
+        lib->m_eglDestroyContext(res->dpy, res->ctx);
+        res->ctx = EGL_NO_CONTEXT;
+        return false;
+    }
+    return true;
+}
+
+bool create_context(EGLBackendContext * res, const char * mode, const char * libgl, const char * libegl, int glversion, int device_index, EGLBackendContext * share, const ContextOptions * options) {
+    {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        if (!libgl) {
+            libgl = find_library(libgl_names, &default_libgl);
+        }
+        if (!libegl) {
+            libegl = find_library(libegl_names, &default_libegl);
+        }
+        res->lib = load_library(libgl, libegl);
+    }
+
+    if (!res->lib) {
+        return false;
+    }
+
+    if (!strcmp(mode, "surfaceless")) {
+        mode = "standalone";
+        device_index = DEVICE_SURFACELESS;
+    }
+
+    if (!strcmp(mode, "standalone")) {
+        if (!create_standalone_context(res, device_index, glversion, share, options)) {
+            return false;
+        }
+        // a context that cannot be made current is destroyed instead of pooled, the caller frees the rest
+        if (!make_current(res->lib, res->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, res->ctx)) {
+            set_error("eglMakeCurrent failed (0x%x)", res->lib->m_eglGetError());
+            remove_share_group_member(res->group, res->ctx);
+            res->lib->m_eglDestroyContext(res->dpy, res->ctx);
+            res->ctx = EGL_NO_CONTEXT;
+            return false;
+        }
+        return true;
+    }
+
+    if (!strcmp(mode, "share")) {
+        return create_shared_context(res, glversion);
+    }
+
+    set_error("unknown mode");
+    return false;
+}
+
+void release_context(EGLBackendContext * self) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (self->display) {
+        track_context(self->lib, self->display, -1);
+    }
+    if (self->ctx) {
+        if (self->lib->m_eglGetCurrentContext() == self->ctx) {
+            make_current(self->lib, self->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        // a context still current on another thread is destroyed, the driver frees it once that thread unbinds it
+        if (!bound_on_any_thread(self->ctx) && recycle_context(self)) {
+            self->display = NULL;
+        } else {
+            remove_share_group_member(self->group, self->ctx);
+            self->lib->m_eglDestroyContext(self->dpy, self->ctx);
+        }
+        self->ctx = EGL_NO_CONTEXT;
+    }
+    if (self->display) {
+        release_display(self->lib, self->display);
+        self->display = NULL;
+    }
+}
+
+void free_context(EGLBackendContext * self) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (self->display) {
+        track_context(self->lib, self->display, -1);
+        release_display(self->lib, self->display);
+        self->display = NULL;
+    }
+    release_library(self->lib);
+    self->lib = NULL;
+}
+
+void * load_proc(EGLBackendContext * self, const char * method) {
+    std::lock_guard<std::mutex> guard(self->lib->procs_lock);
+    SymbolCache::iterator it = self->lib->procs.find(method);
+    if (it != self->lib->procs.end()) {
+        return it->second;
+    }
+    void * proc = (void *)dlsym(self->lib->libgl, method);
+    if (!proc) {
+        proc = (void *)self->lib->m_eglGetProcAddress(method);
+    }
+    self->lib->procs.emplace(method, proc);
+    return proc;
+}
+
+Fence * create_fence(EGLBackendContext * self) {
+    Library * lib = self->lib;
+    if (!lib->m_eglCreateSyncKHR || !lib->m_eglDestroySyncKHR || !lib->m_eglClientWaitSyncKHR) {
+        return create_gl_fence(self);
+    }
+
+    if (!self->ctx) {
+        set_error("the context was released");
+        return NULL;
+    }
+
+    if (!self->enter()) {
+        return NULL;
+    }
+
+    EGLSyncKHR sync = lib->m_eglCreateSyncKHR(self->dpy, EGL_SYNC_FENCE_KHR, NULL);
+    if (sync == EGL_NO_SYNC_KHR) {
+        set_error("eglCreateSyncKHR failed (0x%x)", lib->m_eglGetError());
+        self->exit();
+        return NULL;
+    }
+
+    // the fence only signals once the commands before it reach the GPU
+    ((void (*)())load_proc(self, "glFlush"))();
+    self->exit();
+
+    EGLFence * res = new EGLFence();
+    {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        lib->refcount += 1;
+        if (self->display) {
+            self->display->refcount += 1;
+        }
+    }
+    res->lib = lib;
+    res->display = self->display;
+    res->dpy = self->dpy;
+    res->sync = sync;
+    return res;
+}
+
+EGLFence::~EGLFence() {
+    lib->m_eglDestroySyncKHR(dpy, sync);
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (display) {
+        release_display(lib, display);
+    }
+    release_library(lib);
+}
+
+int EGLFence::client_wait(double timeout) {
+    EGLTimeKHR nanoseconds = timeout < 0.0 ? EGL_FOREVER_KHR : (EGLTimeKHR)(timeout * 1e9);
+    EGLint status = lib->m_eglClientWaitSyncKHR(dpy, sync, 0, nanoseconds);
+    if (status == EGL_CONDITION_SATISFIED_KHR) {
+        return 1;
+    }
+    if (status == EGL_TIMEOUT_EXPIRED_KHR) {
+        return 0;
+    }
+    set_error("eglClientWaitSyncKHR failed (0x%x)", lib->m_eglGetError());
+    return -1;
+}
+
+bool EGLFence::server_wait() {
+    // without EGL_KHR_wait_sync the calling thread waits instead of the GPU
+    if (!lib->m_eglWaitSyncKHR) {
+        return client_wait(-1.0) == 1;
+    }
+    if (!lib->m_eglWaitSyncKHR(dpy, sync, 0)) {
+        set_error("eglWaitSyncKHR failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+    return true;
+}
+
+EGLBackendContext::~EGLBackendContext() {
+    // A context that was never released keeps its libraries loaded
+    if (lib && !ctx) {
+        free_context(this);
+    }
+}
+
+bool EGLBackendContext::enter() {
+    // a failed enter() keeps the current binding and pushes nothing, there is no matching exit()
+    if (!ctx) {
+        set_error("the context was released");
+        return false;
+    }
+    Binding & current = get_current(lib);
+    Binding previous = current;
+    if (!switch_binding(lib, current, dpy, wnd, wnd, ctx)) {
+        set_error("eglMakeCurrent failed (0x%x)", lib->m_eglGetError());
+        return false;
+    }
+    binding_stack.push_back(previous);
+    run_pending_deletions(group);
+    return true;
+}
+
+bool EGLBackendContext::exit() {
+    Binding & current = get_current(lib);
+    if (binding_stack.empty()) {
+        return switch_binding(lib, current, dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    Binding previous = binding_stack.back();
+    binding_stack.pop_back();
+    if (previous.ctx) {
+        return switch_binding(lib, current, previous.dpy, previous.draw, previous.read, previous.ctx);
+    }
+    return switch_binding(lib, current, dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+bool EGLBackendContext::enter_changes_binding() {
+    return !is_current(lib, dpy, wnd, wnd, ctx);
+}
+
+bool EGLBackendContext::exit_changes_binding() {
+    if (binding_stack.empty() || !binding_stack.back().ctx) {
+        return !is_current(lib, dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    const Binding & previous = binding_stack.back();
+    return !is_current(lib, previous.dpy, previous.draw, previous.read, previous.ctx);
+}
+
+void * EGLBackendContext::load(const char * name) {
+    return load_proc(this, name);
+}
+
+void EGLBackendContext::release() {
+    release_context(this);
+}
+
+bool EGLBackendContext::standalone() {
+    return is_standalone;
+}
+
+void * EGLBackendContext::current_native() {
+    return lib->m_eglGetCurrentContext();
+}
+
+bool EGLBackendContext::no_error() {
+    return is_no_error;
+}
+
+int EGLBackendContext::release_behavior() {
+    return release_mode;
+}
+
+Fence * EGLBackendContext::fence() {
+    return create_fence(this);
+}
+
+}
+
+Context * create_egl_context(const char * mode, const char * libgl, const char * libegl, int glversion, int device_index, Context * share, const ContextOptions * options) {
+    EGLBackendContext * res = new EGLBackendContext();
+    if (!create_context(res, mode, libgl, libegl, glversion, device_index, (EGLBackendContext *)share, options)) {
+        delete res;
+        return NULL;
+    }
+    return res;
+}
+
+bool egl_fence_sync_supported(Context * context) {
+    Library * lib = ((EGLBackendContext *)context)->lib;
+    return lib->m_eglCreateSyncKHR && lib->m_eglDestroySyncKHR && lib->m_eglClientWaitSyncKHR;
+}
+
+bool create_egl_share_group(int count, const char * libgl, const char * libegl, int glversion, int device_index, const ContextOptions * options, Context ** contexts) {
+    EGLBackendContext * first = new EGLBackendContext();
+    if (!create_context(first, "standalone", libgl, libegl, glversion, device_index, NULL, options)) {
+        delete first;
+        return false;
+    }
+
+    // the library, display and config are resolved once, only eglCreateContext runs for the other contexts
+    contexts[0] = first;
+    for (int i = 1; i < count; ++i) {
+        EGLBackendContext * res = new EGLBackendContext();
+        {
+            std::lock_guard<std::mutex> guard(registry_lock);
+            first->lib->refcount += 1;
+        }
+        res->lib = first->lib;
+        if (!create_standalone_context(res, device_index, glversion, first, options)) {
+            delete res;
+            for (int j = 0; j < i; ++j) {
+                contexts[j]->release();
+                delete contexts[j];
+            }
+            return false;
+        }
+        contexts[i] = res;
+    }
+    return true;
+}
+
+bool egl_devices(const char * libgl, const char * libegl, std::vector<DeviceInfo> & devices) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (!libgl) {
+        libgl = find_library(libgl_names, &default_libgl);
+    }
+    if (!libegl) {
+        libegl = find_library(libegl_names, &default_libegl);
+    }
+    Library * lib = load_library(libgl, libegl);
+    if (!lib) {
+        return false;
+    }
+    bool success = query_devices(lib);
+    if (success) {
+        devices = lib->device_info;
+    }
+    release_library(lib);
+    return success;
+}
+
+int egl_live_contexts(int * counts, int max_devices) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    int num_devices = 0;
+    for (int i = 0; i < max_devices; ++i) {
+        counts[i] = 0;
+    }
+    for (std::map<std::pair<std::string, std::string>, Library *>::iterator it = libraries.begin(); it != libraries.end(); ++it) {
+        Library * lib = it->second;
+        for (int i = 0; i < (int)lib->live_contexts.size(); ++i) {
+            if (i < max_devices) {
+                counts[i] += lib->live_contexts[i];
+            }
+        }
+        if (num_devices < (int)lib->live_contexts.size()) {
+            num_devices = (int)lib->live_contexts.size();
+        }
+    }
+    return num_devices;
+}
+
+void configure_egl_pool(int max_size, double max_idle) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    pool.max_size = max_size;
+    pool.max_idle = max_idle;
+    evict_pooled_contexts(max_size);
+}
+
+PoolStats egl_pool_stats() {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    evict_pooled_contexts(pool.max_size);
+    PoolStats stats;
+    stats.size = (int)pool.entries.size();
+    stats.max_size = pool.max_size;
+    stats.hits = pool.hits;
+    stats.misses = pool.misses;
+    stats.evictions = pool.evictions;
+    return stats;
+}
+
+}
+
+glcontext_context * glcontext_create_egl(const char * mode, const char * libgl, const char * libegl, int glversion, int device_index) {
+    return (glcontext_context *)glcontext::create_egl_context(mode ? mode : "standalone", libgl, libegl, glversion, device_index, NULL, NULL);
+}
+
+glcontext_context * glcontext_create_egl_ex(const char * mode, const char * libgl, const char * libegl, int glversion, int device_index, const glcontext_options * options) {
+    return (glcontext_context *)glcontext::create_egl_context(mode ? mode : "standalone", libgl, libegl, glversion, device_index, NULL, options);
+}
+
+int glcontext_create_egl_share_group(int count, const char * libgl, const char * libegl, int glversion, int device_index, glcontext_context ** contexts) {
+    return glcontext::create_egl_share_group(count, libgl, libegl, glversion, device_index, NULL, (glcontext::Context **)contexts);
+}
+
+glcontext_context * glcontext_create_egl_shared(glcontext_context * share, int glversion) {
+    glcontext::EGLBackendContext * context = (glcontext::EGLBackendContext *)share;
+    return (glcontext_context *)glcontext::create_egl_context("standalone", context->lib->key.first.c_str(), context->lib->key.second.c_str(), glversion, 0, context, NULL);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+/* C interface of the glcontext core library. Every function can be called from any thread. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct glcontext_context glcontext_context;
+typedef struct glcontext_fence glcontext_fence;
+typedef struct glcontext_frame_pacer glcontext_frame_pacer;
+
+/* Negative device indices place egl contexts on the device with the fewest live contexts or in turn. */
+#define GLCONTEXT_DEVICE_ROUND_ROBIN -1
+#define GLCONTEXT_DEVICE_LEAST_CONTEXTS -2
+#define GLCONTEXT_DEVICE_PREFER_HARDWARE -3
+/* Standalone egl contexts on the surfaceless platform (EGL_MESA_platform_surfaceless), the same as mode "surfaceless". */
+#define GLCONTEXT_DEVICE_SURFACELESS -4
+
+/* Whether the driver flushes a context when it stops being current (KHR_context_flush_control). */
+#define GLCONTEXT_RELEASE_FLUSH 0
+#define GLCONTEXT_RELEASE_NONE 1
+
+/* Optional creation attributes, NULL or a zeroed struct selects the defaults. */
+typedef struct glcontext_options {
+    /* Config attributes of the backend terminated by EGL_NONE or None, the matching config using the least memory is selected. */
+    const int * config_attribs;
+    /* egl: create the context without a config (EGL_KHR_no_config_context), it has no default framebuffer. */
+    int no_config;
+    /* Create standalone contexts without error checking (KHR_no_error), a regular context is created without the extension. */
+    int no_error;
+    /* GLCONTEXT_RELEASE_NONE skips the implicit flush when standalone contexts are switched, the driver flushes without the extension. */
+    int release_behavior;
+} glcontext_options;
+
+/* Return NULL on failure, the reason is reported by glcontext_last_error(). */
+glcontext_context * glcontext_create_egl(const char * mode, const char * libgl, const char * libegl, int glversion, int device_index);
+glcontext_context * glcontext_create_egl_ex(const char * mode, const char * libgl, const char * libegl, int glversion, int device_index, const glcontext_options * options);
+glcontext_context * glcontext_create_egl_shared(glcontext_context * share, int glversion);
+/* Fill contexts with count standalone contexts sharing their objects, return 0 on failure. */
+int glcontext_create_egl_share_group(int count, const char * libgl, const char * libegl, int glversion, int device_index, glcontext_context ** contexts);
+glcontext_context * glcontext_create_x11(const char * mode, const char * libgl, const char * libx11, int glversion);
+glcontext_context * glcontext_create_x11_ex(const char * mode, const char * libgl, const char * libx11, int glversion, const glcontext_options * options);
+
+/* Return 0 and keep the current binding on failure, glcontext_exit() must not be called then. */
+int glcontext_enter(glcontext_context * context);
+int glcontext_exit(glcontext_context * context);
+void * glcontext_load(glcontext_context * context, const char * name);
+void glcontext_release(glcontext_context * context);
+void glcontext_destroy(glcontext_context * context);
+/* Return 1 if the context was created without error checking. */
+int glcontext_no_error(glcontext_context * context);
+/* Return the release behavior the context was created with, GLCONTEXT_RELEASE_FLUSH without the extension. */
+int glcontext_release_behavior(glcontext_context * context);
+
+/* Fences hand objects over between contexts of a share group. The context must outlive its fences. */
+glcontext_fence * glcontext_create_fence(glcontext_context * context);
+/* Return 1 when signaled, 0 on timeout and -1 on failure, a negative timeout in seconds waits forever. */
+int glcontext_fence_client_wait(glcontext_fence * fence, double timeout);
+int glcontext_fence_server_wait(glcontext_fence * fence);
+void glcontext_fence_destroy(glcontext_fence * fence);
+
+/* glcontext_begin_frame() blocks while max_frames frames are still running on the GPU. */
+glcontext_frame_pacer * glcontext_create_frame_pacer(glcontext_context * context, int max_frames);
+int glcontext_begin_frame(glcontext_frame_pacer * pacer);
+int glcontext_end_frame(glcontext_frame_pacer * pacer);
+void glcontext_frame_pacer_destroy(glcontext_frame_pacer * pacer);
+
+const char * glcontext_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
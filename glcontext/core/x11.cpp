@@ -0,0 +1,1011 @@
+#include "context.hpp"
+#include "glcontext.h"
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dlfcn.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+namespace glcontext {
+
+namespace {
+
+#define GLX_CONTEXT_MAJOR_VERSION 0x2091
+#define GLX_CONTEXT_MINOR_VERSION 0x2092
+#define GLX_CONTEXT_PROFILE_MASK 0x9126
+#define GLX_CONTEXT_CORE_PROFILE_BIT 0x0001
+#define GLX_CONTEXT_OPENGL_NO_ERROR_ARB 0x31B3
+#define GLX_CONTEXT_RELEASE_BEHAVIOR_ARB 0x2097
+#define GLX_CONTEXT_RELEASE_BEHAVIOR_NONE_ARB 0
+
+#define GLX_RGBA 4
+#define GLX_DOUBLEBUFFER 5
+#define GLX_RED_SIZE 8
+#define GLX_GREEN_SIZE 9
+#define GLX_BLUE_SIZE 10
+#define GLX_DEPTH_SIZE 12
+#define GLX_BUFFER_SIZE 2
+#define GLX_STENCIL_SIZE 13
+#define GLX_SAMPLES 100001
+
+typedef struct __GLXcontextRec * GLXContext;
+typedef struct __GLXFBConfigRec * GLXFBConfig;
+typedef XID GLXDrawable;
+
+typedef GLXFBConfig * (* m_glXChooseFBConfigProc)(Display *, int, const int *, int *);
+typedef XVisualInfo * (* m_glXChooseVisualProc)(Display *, int, int *);
+typedef Display * (* m_glXGetCurrentDisplayProc)();
+typedef GLXContext (* m_glXGetCurrentContextProc)();
+typedef GLXDrawable (* m_glXGetCurrentDrawableProc)();
+typedef Bool (* m_glXMakeCurrentProc)(Display *, GLXDrawable, GLXContext);
+typedef void (* m_glXDestroyContextProc)(Display *, GLXContext);
+typedef GLXContext (* m_glXCreateContextProc)(Display *, XVisualInfo *, GLXContext, Bool);
+typedef void (*(* m_glXGetProcAddressProc)(const unsigned char *))();
+typedef GLXContext (* m_glXCreateContextAttribsARBProc)(Display *, GLXFBConfig, GLXContext, int, const int *);
+typedef int (* m_glXGetFBConfigAttribProc)(Display *, GLXFBConfig, int, int *);
+typedef XVisualInfo * (* m_glXGetVisualFromFBConfigProc)(Display *, GLXFBConfig);
+typedef const char * (* m_glXQueryExtensionsStringProc)(Display *, int);
+
+typedef Display * (* m_XOpenDisplayProc)(const char *);
+typedef int (* m_XDefaultScreenProc)(Display *);
+typedef Window (* m_XRootWindowProc)(Display *, int);
+typedef Colormap (* m_XCreateColormapProc)(Display *, Window, Visual *, int);
+typedef Window (* m_XCreateWindowProc)(Display *, Window, int, int, unsigned int, unsigned int, unsigned int, int, unsigned int, Visual *, unsigned long, XSetWindowAttributes *);
+typedef int (* m_XDestroyWindowProc)(Display *, Window);
+typedef int (* m_XCloseDisplayProc)(Display *);
+typedef int (* m_XFreeProc)(void *);
+typedef XErrorHandler (* m_XSetErrorHandlerProc)(XErrorHandler);
+
+int SilentXErrorHandler(Display * d, XErrorEvent * e) {
+    return 0;
+}
+
+// Loaded libraries are shared by every context created with the same libGL and libX11.
+// The resolved GLX and X11 functions and the OpenGL function cache live as long as the libraries are loaded.
+// The last context closes the handles, but driver code is never unmapped (see load_library).
+typedef std::unordered_map<std::string, void *> SymbolCache;
+
+struct Library {
+    int refcount;
+    std::pair<std::string, std::string> key;
+
+    void * libgl;
+    void * libx11;
+    SymbolCache procs;
+    std::mutex procs_lock;
+
+    m_glXChooseFBConfigProc m_glXChooseFBConfig;
+    m_glXChooseVisualProc m_glXChooseVisual;
+    m_glXGetCurrentDisplayProc m_glXGetCurrentDisplay;
+    m_glXGetCurrentContextProc m_glXGetCurrentContext;
+    m_glXGetCurrentDrawableProc m_glXGetCurrentDrawable;
+    m_glXMakeCurrentProc m_glXMakeCurrent;
+    m_glXDestroyContextProc m_glXDestroyContext;
+    m_glXCreateContextProc m_glXCreateContext;
+    m_glXGetProcAddressProc m_glXGetProcAddress;
+    m_glXCreateContextAttribsARBProc m_glXCreateContextAttribsARB;
+    m_glXGetFBConfigAttribProc m_glXGetFBConfigAttrib;
+    m_glXGetVisualFromFBConfigProc m_glXGetVisualFromFBConfig;
+    m_glXQueryExtensionsStringProc m_glXQueryExtensionsString;
+
+    m_XOpenDisplayProc m_XOpenDisplay;
+    m_XDefaultScreenProc m_XDefaultScreen;
+    m_XRootWindowProc m_XRootWindow;
+    m_XCreateColormapProc m_XCreateColormap;
+    m_XCreateWindowProc m_XCreateWindow;
+    m_XDestroyWindowProc m_XDestroyWindow;
+    m_XCloseDisplayProc m_XCloseDisplay;
+    m_XFreeProc m_XFree;
+    m_XSetErrorHandlerProc m_XSetErrorHandler;
+};
+
+std::map<std::pair<std::string, std::string>, Library *> libraries;
+
+// Guards the library registry and the context pool. Xlib is not initialized for threads and the X error handler
+// is process wide, so contexts are also created and destroyed while holding it.
+std::mutex registry_lock;
+
+class X11BackendContext : public Context {
+  public:
+    Library * lib;
+    Display * dpy;
+    GLXFBConfig * fbc;
+    XVisualInfo * vi;
+    Window wnd;
+    GLXContext ctx;
+
+    int is_standalone;
+    int own_window;
+    int custom_config;
+    int is_no_error;
+    int release_mode;
+    int requested_no_error;
+    int requested_release_mode;
+    int glversion;
+
+    X11BackendContext() : lib(NULL), dpy(NULL), fbc(NULL), vi(NULL), wnd(0), ctx(NULL), is_standalone(false), own_window(false), custom_config(false), is_no_error(false), release_mode(GLCONTEXT_RELEASE_FLUSH), requested_no_error(false), requested_release_mode(GLCONTEXT_RELEASE_FLUSH), glversion(0) {}
+    ~X11BackendContext();
+
+    bool enter();
+    bool exit();
+    bool enter_changes_binding();
+    bool exit_changes_binding();
+    void * load(const char * name);
+    void release();
+    bool standalone();
+    bool no_error();
+    int release_behavior();
+    Fence * fence();
+    void * current_native();
+};
+
+// Released standalone contexts are kept for reuse when pooling is enabled with configure_x11_pool().
+// A pooled context keeps its display connection, window and library reference and is only handed out
+// for the same library, OpenGL version, error checking and release behavior it was created with.
+// Requests are matched on the options asked for, the driver may have fallen back to a regular context.
+struct PooledContext {
+    Library * lib;
+    Display * dpy;
+    GLXFBConfig * fbc;
+    XVisualInfo * vi;
+    Window wnd;
+    GLXContext ctx;
+    ShareGroup * group;
+    int no_error;
+    int release_mode;
+    int requested_no_error;
+    int requested_release_mode;
+    int glversion;
+    std::chrono::steady_clock::time_point released;
+};
+
+struct ContextPool {
+    int max_size;
+    double max_idle;
+    long long hits;
+    long long misses;
+    long long evictions;
+    std::deque<PooledContext> entries;
+};
+
+ContextPool pool;
+
+bool load_library_procs(Library * lib) {
+    lib->m_glXChooseFBConfig = (m_glXChooseFBConfigProc)dlsym(lib->libgl, "glXChooseFBConfig");
+    if (!lib->m_glXChooseFBConfig) {
+        set_error("glXChooseFBConfig not found");
+        return false;
+    }
+
+    lib->m_glXChooseVisual = (m_glXChooseVisualProc)dlsym(lib->libgl, "glXChooseVisual");
+    if (!lib->m_glXChooseVisual) {
+        set_error("glXChooseVisual not found");
+        return false;
+    }
+
+    lib->m_glXGetCurrentDisplay = (m_glXGetCurrentDisplayProc)dlsym(lib->libgl, "glXGetCurrentDisplay");
+    if (!lib->m_glXGetCurrentDisplay) {
+        set_error("glXGetCurrentDisplay not found");
+        return false;
+    }
+
+    lib->m_glXGetCurrentContext = (m_glXGetCurrentContextProc)dlsym(lib->libgl, "glXGetCurrentContext");
+    if (!lib->m_glXGetCurrentContext) {
+        set_error("glXGetCurrentContext not found");
+        return false;
+    }
+
+    lib->m_glXGetCurrentDrawable = (m_glXGetCurrentDrawableProc)dlsym(lib->libgl, "glXGetCurrentDrawable");
+    if (!lib->m_glXGetCurrentDrawable) {
+        set_error("glXGetCurrentDrawable not found");
+        return false;
+    }
+
+    lib->m_glXMakeCurrent = (m_glXMakeCurrentProc)dlsym(lib->libgl, "glXMakeCurrent");
+    if (!lib->m_glXMakeCurrent) {
+        set_error("glXMakeCurrent not found");
+        return false;
+    }
+
+    lib->m_glXDestroyContext = (m_glXDestroyContextProc)dlsym(lib->libgl, "glXDestroyContext");
+    if (!lib->m_glXDestroyContext) {
+        set_error("glXDestroyContext not found");
+        return false;
+    }
+
+    lib->m_glXCreateContext = (m_glXCreateContextProc)dlsym(lib->libgl, "glXCreateContext");
+    if (!lib->m_glXCreateContext) {
+        set_error("glXCreateContext not found");
+        return false;
+    }
+
+    lib->m_glXGetProcAddress = (m_glXGetProcAddressProc)dlsym(lib->libgl, "glXGetProcAddress");
+    if (!lib->m_glXGetProcAddress) {
+        set_error("glXGetProcAddress not found");
+        return false;
+    }
+
+    void (* proc)() = lib->m_glXGetProcAddress((const unsigned char *)"glXCreateContextAttribsARB");
+    lib->m_glXCreateContextAttribsARB = (m_glXCreateContextAttribsARBProc)proc;
+
+    lib->m_glXGetFBConfigAttrib = (m_glXGetFBConfigAttribProc)dlsym(lib->libgl, "glXGetFBConfigAttrib");
+    lib->m_glXGetVisualFromFBConfig = (m_glXGetVisualFromFBConfigProc)dlsym(lib->libgl, "glXGetVisualFromFBConfig");
+    lib->m_glXQueryExtensionsString = (m_glXQueryExtensionsStringProc)dlsym(lib->libgl, "glXQueryExtensionsString");
+
+    if (lib->libx11) {
+        lib->m_XOpenDisplay = (m_XOpenDisplayProc)dlsym(lib->libx11, "XOpenDisplay");
+        if (!lib->m_XOpenDisplay) {
+            set_error("(detect) XOpenDisplay not found");
+            return false;
+        }
+
+        lib->m_XDefaultScreen = (m_XDefaultScreenProc)dlsym(lib->libx11, "XDefaultScreen");
+        if (!lib->m_XDefaultScreen) {
+            set_error("(detect) XDefaultScreen not found");
+            return false;
+        }
+
+        lib->m_XRootWindow = (m_XRootWindowProc)dlsym(lib->libx11, "XRootWindow");
+        if (!lib->m_XRootWindow) {
+            set_error("(detect) XRootWindow not found");
+            return false;
+        }
+
+        lib->m_XCreateColormap = (m_XCreateColormapProc)dlsym(lib->libx11, "XCreateColormap");
+        if (!lib->m_XCreateColormap) {
+            set_error("(detect) XCreateColormap not found");
+            return false;
+        }
+
+        lib->m_XCreateWindow = (m_XCreateWindowProc)dlsym(lib->libx11, "XCreateWindow");
+        if (!lib->m_XCreateWindow) {
+            set_error("(detect) XCreateWindow not found");
+            return false;
+        }
+
+        lib->m_XDestroyWindow = (m_XDestroyWindowProc)dlsym(lib->libx11, "XDestroyWindow");
+        if (!lib->m_XDestroyWindow) {
+            set_error("(detect) XDestroyWindow not found");
+            return false;
+        }
+
+        lib->m_XCloseDisplay = (m_XCloseDisplayProc)dlsym(lib->libx11, "XCloseDisplay");
+        if (!lib->m_XCloseDisplay) {
+            set_error("(detect) XCloseDisplay not found");
+            return false;
+        }
+
+        lib->m_XFree = (m_XFreeProc)dlsym(lib->libx11, "XFree");
+        if (!lib->m_XFree) {
+            set_error("(detect) XFree not found");
+            return false;
+        }
+
+        lib->m_XSetErrorHandler = (m_XSetErrorHandlerProc)dlsym(lib->libx11, "XSetErrorHandler");
+        if (!lib->m_XSetErrorHandler) {
+            set_error("(detect) XSetErrorHandler not found");
+            return false;
+        }
+    }
+    return true;
+}
+
+void free_library(Library * lib) {
+    if (lib->libx11) {
+        dlclose(lib->libx11);
+    }
+    if (lib->libgl) {
+        dlclose(lib->libgl);
+    }
+    delete lib;
+}
+
+Library * load_library(const char * libgl, const char * libx11) {
+    std::pair<std::string, std::string> key(libgl, libx11 ? libx11 : "");
+    std::map<std::pair<std::string, std::string>, Library *>::iterator it = libraries.find(key);
+    if (it != libraries.end()) {
+        it->second->refcount += 1;
+        return it->second;
+    }
+
+    Library * lib = new Library();
+    lib->refcount = 1;
+    lib->key = key;
+
+    // Drivers register thread exit handlers, their code must stay mapped after the last context is released.
+    lib->libgl = dlopen(libgl, RTLD_LAZY | RTLD_NODELETE);
+    if (!lib->libgl) {
+        set_error("%s not found in /lib, /usr/lib or LD_LIBRARY_PATH", libgl);
+        free_library(lib);
+        return NULL;
+    }
+
+    if (libx11) {
+        lib->libx11 = dlopen(libx11, RTLD_LAZY | RTLD_NODELETE);
+        if (!lib->libx11) {
+            set_error("(detect) %s not loaded", libx11);
+            free_library(lib);
+            return NULL;
+        }
+    }
+
+    if (!load_library_procs(lib)) {
+        free_library(lib);
+        return NULL;
+    }
+
+    libraries[key] = lib;
+    return lib;
+}
+
+void release_library(Library * lib) {
+    lib->refcount -= 1;
+    if (!lib->refcount) {
+        libraries.erase(lib->key);
+        free_library(lib);
+    }
+}
+
+void destroy_pooled_context(PooledContext & entry) {
+    remove_share_group_member(entry.group, entry.ctx);
+    release_share_group(entry.group);
+    entry.lib->m_glXDestroyContext(entry.dpy, entry.ctx);
+    entry.lib->m_XDestroyWindow(entry.dpy, entry.wnd);
+    entry.lib->m_XFree(entry.fbc);
+    entry.lib->m_XFree(entry.vi);
+    entry.lib->m_XCloseDisplay(entry.dpy);
+    release_library(entry.lib);
+}
+
+void evict_pooled_contexts(int max_size) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (pool.entries.size()) {
+        PooledContext & entry = pool.entries.front();
+        std::chrono::duration<double> idle = now - entry.released;
+        if ((int)pool.entries.size() <= max_size && (pool.max_idle <= 0.0 || idle.count() < pool.max_idle)) {
+            break;
+        }
+        destroy_pooled_context(entry);
+        pool.entries.pop_front();
+        pool.evictions += 1;
+    }
+}
+
+bool acquire_pooled_context(X11BackendContext * res, int glversion) {
+    if (!pool.max_size) {
+        return false;
+    }
+    evict_pooled_contexts(pool.max_size);
+    for (std::deque<PooledContext>::reverse_iterator it = pool.entries.rbegin(); it != pool.entries.rend(); ++it) {
+        if (it->lib == res->lib && it->glversion == glversion && it->requested_no_error == res->requested_no_error && it->requested_release_mode == res->requested_release_mode) {
+            res->dpy = it->dpy;
+            res->fbc = it->fbc;
+            res->vi = it->vi;
+            res->wnd = it->wnd;
+            res->ctx = it->ctx;
+            res->group = it->group;
+            res->is_no_error = it->no_error;
+            res->release_mode = it->release_mode;
+            res->glversion = it->glversion;
+            release_library(it->lib);
+            pool.entries.erase(--it.base());
+            pool.hits += 1;
+            return true;
+        }
+    }
+    pool.misses += 1;
+    return false;
+}
+
+bool recycle_context(X11BackendContext * self) {
+    if (!pool.max_size || !self->own_window || self->custom_config) {
+        return false;
+    }
+    evict_pooled_contexts(pool.max_size - 1);
+    PooledContext entry;
+    entry.lib = self->lib;
+    entry.dpy = self->dpy;
+    entry.fbc = self->fbc;
+    entry.vi = self->vi;
+    entry.wnd = self->wnd;
+    entry.ctx = self->ctx;
+    entry.group = retain_share_group(self->group);
+    entry.no_error = self->is_no_error;
+    entry.release_mode = self->release_mode;
+    entry.requested_no_error = self->requested_no_error;
+    entry.requested_release_mode = self->requested_release_mode;
+    entry.glversion = self->glversion;
+    entry.released = std::chrono::steady_clock::now();
+    self->lib->refcount += 1;
+    pool.entries.push_back(entry);
+    return true;
+}
+
+// The binding made current through this module on the calling thread and the bindings to restore
+// when leaving nested enter() calls. glXGetCurrentContext is a cheap client side query, it is used to
+// detect bindings changed by other libraries.
+struct Binding {
+    Display * dpy;
+    GLXDrawable wnd;
+    GLXContext ctx;
+};
+
+thread_local Binding current_binding;
+thread_local std::vector<Binding> binding_stack;
+
+Binding & get_current(Library * lib) {
+    Binding & current = current_binding;
+    GLXContext ctx = lib->m_glXGetCurrentContext();
+    if (ctx != current.ctx) {
+        current.dpy = lib->m_glXGetCurrentDisplay();
+        current.wnd = lib->m_glXGetCurrentDrawable();
+        current.ctx = ctx;
+    }
+    return current;
+}
+
+bool is_bound(const Binding & current, Display * dpy, GLXDrawable wnd, GLXContext ctx) {
+    return current.ctx == ctx && (!ctx || (current.dpy == dpy && current.wnd == wnd));
+}
+
+bool is_current(Library * lib, Display * dpy, GLXDrawable wnd, GLXContext ctx) {
+    return is_bound(get_current(lib), dpy, wnd, ctx);
+}
+
+// The current binding is passed in by callers that already queried it.
+Bool switch_binding(Library * lib, Binding & current, Display * dpy, GLXDrawable wnd, GLXContext ctx) {
+    if (is_bound(current, dpy, wnd, ctx)) {
+        return true;
+    }
+    if (!lib->m_glXMakeCurrent(dpy, wnd, ctx)) {
+        current.ctx = NULL;
+        return false;
+    }
+    track_binding(current.ctx, ctx);
+    current.dpy = dpy;
+    current.wnd = wnd;
+    current.ctx = ctx;
+    return true;
+}
+
+Bool make_current(Library * lib, Display * dpy, GLXDrawable wnd, GLXContext ctx) {
+    return switch_binding(lib, get_current(lib), dpy, wnd, ctx);
+}
+
+// Library names tried in order when the caller does not pass one in.
+// dlopen searches the same paths as ldconfig, the first name that loads is remembered for the process.
+const char * libgl_names[] = {"libGL.so.1", "libGL.so", NULL};
+const char * libx11_names[] = {"libX11.so.6", "libX11.so", NULL};
+
+const char * find_library(const char ** names, const char ** found) {
+    if (*found) {
+        return *found;
+    }
+    int index = 0;
+    while (names[index + 1]) {
+        void * handle = dlopen(names[index], RTLD_LAZY);
+        if (handle) {
+            dlclose(handle);
+            break;
+        }
+        index += 1;
+    }
+    // the last name is used as is, so a failure is reported when the library is loaded
+    *found = names[index];
+    return *found;
+}
+
+// Move the matching config with the smallest default framebuffer to the front, multisampled buffers count once per sample.
+// FBConfigs belong to the display connection of a context, so unlike egl the selection is not cached.
+void select_cheapest_config(Library * lib, Display * dpy, GLXFBConfig * fbc, int count) {
+    if (!lib->m_glXGetFBConfigAttrib) {
+        return;
+    }
+    int best = 0;
+    long long best_cost = -1;
+    for (int i = 0; i < count; ++i) {
+        int buffer_size = 0, depth_size = 0, stencil_size = 0, samples = 0;
+        lib->m_glXGetFBConfigAttrib(dpy, fbc[i], GLX_BUFFER_SIZE, &buffer_size);
+        lib->m_glXGetFBConfigAttrib(dpy, fbc[i], GLX_DEPTH_SIZE, &depth_size);
+        lib->m_glXGetFBConfigAttrib(dpy, fbc[i], GLX_STENCIL_SIZE, &stencil_size);
+        lib->m_glXGetFBConfigAttrib(dpy, fbc[i], GLX_SAMPLES, &samples);
+        long long cost = (long long)(buffer_size + depth_size + stencil_size) * (samples > 1 ? samples : 1);
+        if (best_cost < 0 || cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    GLXFBConfig temp = fbc[0];
+    fbc[0] = fbc[best];
+    fbc[best] = temp;
+}
+
+bool has_glx_extension(Library * lib, Display * dpy, const char * name) {
+    const char * extensions = lib->m_glXQueryExtensionsString ? lib->m_glXQueryExtensionsString(dpy, lib->m_XDefaultScreen(dpy)) : NULL;
+    size_t length = strlen(name);
+    while (extensions && *extensions) {
+        const char * end = strchr(extensions, ' ');
+        if (!end) {
+            end = extensions + strlen(extensions);
+        }
+        if ((size_t)(end - extensions) == length && !strncmp(extensions, name, length)) {
+            return true;
+        }
+        extensions = *end ? end + 1 : end;
+    }
+    return false;
+}
+
+bool create_context(X11BackendContext * res, const char * mode, const char * libgl, const char * libx11, int glversion, const ContextOptions * options) {
+    static const char * default_libgl;
+    static const char * default_libx11;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+
+    if (!libgl) {
+        libgl = find_library(libgl_names, &default_libgl);
+    }
+
+    if (!libx11) {
+        libx11 = find_library(libx11_names, &default_libx11);
+    }
+
+    res->lib = load_library(libgl, strcmp(mode, "detect") ? libx11 : NULL);
+    if (!res->lib) {
+        return false;
+    }
+
+    Library * lib = res->lib;
+
+    if (options && options->no_config) {
+        set_error("no_config is only supported by the egl backend");
+        return false;
+    }
+
+    res->custom_config = options && options->config_attribs;
+    const int * config_attribs = res->custom_config ? options->config_attribs : 0;
+
+    if (!strcmp(mode, "detect")) {
+        res->is_standalone = false;
+        res->own_window = false;
+
+        res->ctx = lib->m_glXGetCurrentContext();
+        if (!res->ctx) {
+            set_error("(detect) glXGetCurrentContext: cannot detect OpenGL context");
+            return false;
+        }
+
+        res->wnd = lib->m_glXGetCurrentDrawable();
+        if (!res->wnd) {
+            set_error("(detect) glXGetCurrentDrawable failed");
+            return false;
+        }
+
+        res->dpy = lib->m_glXGetCurrentDisplay();
+        if (!res->dpy) {
+            set_error("(detect) glXGetCurrentDisplay failed");
+            return false;
+        }
+
+        res->fbc = NULL;
+        res->vi = NULL;
+        return true;
+    }
+
+    if (!strcmp(mode, "share")) {
+        res->is_standalone = true;
+        res->own_window = false;
+
+        GLXContext ctx_share = lib->m_glXGetCurrentContext();
+        if (!ctx_share) {
+            set_error("(share) glXGetCurrentContext: cannot detect OpenGL context");
+            return false;
+        }
+
+        res->wnd = lib->m_glXGetCurrentDrawable();
+        if (!res->wnd) {
+            set_error("(share) glXGetCurrentDrawable failed");
+            return false;
+        }
+
+        res->dpy = lib->m_glXGetCurrentDisplay();
+        if (!res->dpy) {
+            set_error("(share) glXGetCurrentDisplay failed");
+            return false;
+        }
+
+        int nelements = 0;
+        res->fbc = lib->m_glXChooseFBConfig(res->dpy, lib->m_XDefaultScreen(res->dpy), config_attribs, &nelements);
+
+        if (!res->fbc || !nelements) {
+            lib->m_XCloseDisplay(res->dpy);
+            set_error("(share) glXChooseFBConfig failed");
+            return false;
+        }
+
+        if (res->custom_config) {
+            select_cheapest_config(lib, res->dpy, res->fbc, nelements);
+        }
+
+        static int attribute_list[] = {
+            GLX_RGBA,
+            GLX_DOUBLEBUFFER,
+            GLX_RED_SIZE, 8,
+            GLX_GREEN_SIZE, 8,
+            GLX_BLUE_SIZE, 8,
+            GLX_DEPTH_SIZE, 24,
+            None,
+        };
+
+        res->vi = lib->m_glXChooseVisual(res->dpy, lib->m_XDefaultScreen(res->dpy), attribute_list);
+
+        if (!res->vi) {
+            lib->m_XCloseDisplay(res->dpy);
+            set_error("(share) glXChooseVisual:  cannot choose visual");
+            return false;
+        }
+
+        lib->m_XSetErrorHandler(SilentXErrorHandler);
+
+        if (glversion) {
+            if (!lib->m_glXCreateContextAttribsARB) {
+                set_error("(share) glXCreateContextAttribsARB not found");
+                return false;
+            }
+
+            int attribs[] = {
+                GLX_CONTEXT_PROFILE_MASK, GLX_CONTEXT_CORE_PROFILE_BIT,
+                GLX_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
+                GLX_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
+                0, 0,
+            };
+
+            res->ctx = lib->m_glXCreateContextAttribsARB(res->dpy, *res->fbc, ctx_share, true, attribs);
+        } else {
+            res->ctx = lib->m_glXCreateContext(res->dpy, res->vi, ctx_share, true);
+        }
+
+        if (!res->ctx) {
+            set_error("(share) cannot create context");
+            return false;
+        }
+
+        lib->m_XSetErrorHandler(NULL);
+
+        if (!make_current(lib, res->dpy, res->wnd, res->ctx)) {
+            set_error("(share) glXMakeCurrent failed");
+            return false;
+        }
+
+        return true;
+    }
+
+    if (!strcmp(mode, "standalone")) {
+        res->is_standalone = true;
+        res->own_window = true;
+        res->is_no_error = options && options->no_error && glversion;
+        res->release_mode = options && glversion ? options->release_behavior : GLCONTEXT_RELEASE_FLUSH;
+        res->requested_no_error = res->is_no_error;
+        res->requested_release_mode = res->release_mode;
+
+        if (!res->custom_config && acquire_pooled_context(res, glversion)) {
+            if (!make_current(lib, res->dpy, res->wnd, res->ctx)) {
+                set_error("(standalone) glXMakeCurrent failed");
+                return false;
+            }
+            return true;
+        }
+
+        res->glversion = glversion;
+        res->dpy = lib->m_XOpenDisplay(NULL);
+
+        if (!res->dpy) {
+            res->dpy = lib->m_XOpenDisplay(":0.0");
+        }
+
+        if (!res->dpy) {
+            set_error("(standalone) XOpenDisplay: cannot open display");
+            return false;
+        }
+
+        int nelements = 0;
+        res->fbc = lib->m_glXChooseFBConfig(res->dpy, lib->m_XDefaultScreen(res->dpy), config_attribs, &nelements);
+
+        if (!res->fbc || !nelements) {
+            lib->m_XCloseDisplay(res->dpy);
+            set_error("(standalone) glXChooseFBConfig failed");
+            return false;
+        }
+
+        if (res->custom_config) {
+            select_cheapest_config(lib, res->dpy, res->fbc, nelements);
+        }
+
+        static int attribute_list[] = {
+            GLX_RGBA,
+            GLX_DOUBLEBUFFER,
+            GLX_RED_SIZE, 8,
+            GLX_GREEN_SIZE, 8,
+            GLX_BLUE_SIZE, 8,
+            GLX_DEPTH_SIZE, 24,
+            None,
+        };
+
+        // the window of a custom config must use its visual
+        if (res->custom_config && lib->m_glXGetVisualFromFBConfig) {
+            res->vi = lib->m_glXGetVisualFromFBConfig(res->dpy, *res->fbc);
+        } else {
+            res->vi = lib->m_glXChooseVisual(res->dpy, lib->m_XDefaultScreen(res->dpy), attribute_list);
+        }
+
+        if (!res->vi) {
+            lib->m_XCloseDisplay(res->dpy);
+            set_error("(standalone) glXChooseVisual: cannot choose visual");
+            return false;
+        }
+
+        XSetWindowAttributes swa;
+        swa.colormap = lib->m_XCreateColormap(res->dpy, lib->m_XRootWindow(res->dpy, res->vi->screen), res->vi->visual, AllocNone);
+        swa.border_pixel = 0;
+        swa.event_mask = StructureNotifyMask;
+
+        res->wnd = lib->m_XCreateWindow(
+            res->dpy, lib->m_XRootWindow(res->dpy, res->vi->screen), 0, 0, 1, 1, 0, res->vi->depth, InputOutput,
+            res->vi->visual, CWBorderPixel | CWColormap | CWEventMask, &swa
+        );
+
+        if (!res->wnd) {
+            lib->m_XCloseDisplay(res->dpy);
+            set_error("(standalone) XCreateWindow: cannot create window");
+            return false;
+        }
+
+        lib->m_XSetErrorHandler(SilentXErrorHandler);
+
+        if (glversion) {
+            if (!lib->m_glXCreateContextAttribsARB) {
+                set_error("(standalone) glXCreateContextAttribsARB not found");
+                return false;
+            }
+
+            // without the extension a regular context is created, no_error() reports the outcome
+            if (res->is_no_error && !has_glx_extension(lib, res->dpy, "GLX_ARB_create_context_no_error")) {
+                res->is_no_error = false;
+            }
+
+            if (res->release_mode == GLCONTEXT_RELEASE_NONE && !has_glx_extension(lib, res->dpy, "GLX_ARB_context_flush_control")) {
+                res->release_mode = GLCONTEXT_RELEASE_FLUSH;
+            }
+
+            std::vector<int> attribs = {
+                GLX_CONTEXT_PROFILE_MASK, GLX_CONTEXT_CORE_PROFILE_BIT,
+                GLX_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
+                GLX_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
+            };
+            if (res->is_no_error) {
+                attribs.push_back(GLX_CONTEXT_OPENGL_NO_ERROR_ARB);
+                attribs.push_back(1);
+            }
+            if (res->release_mode == GLCONTEXT_RELEASE_NONE) {
+                attribs.push_back(GLX_CONTEXT_RELEASE_BEHAVIOR_ARB);
+                attribs.push_back(GLX_CONTEXT_RELEASE_BEHAVIOR_NONE_ARB);
+            }
+            attribs.push_back(0);
+            attribs.push_back(0);
+
+            res->ctx = lib->m_glXCreateContextAttribsARB(res->dpy, *res->fbc, NULL, true, attribs.data());
+        } else {
+            res->ctx = lib->m_glXCreateContext(res->dpy, res->vi, NULL, true);
+        }
+
+        if (!res->ctx) {
+            set_error("(standalone) cannot create context");
+            return false;
+        }
+
+        lib->m_XSetErrorHandler(NULL);
+
+        if (!make_current(lib, res->dpy, res->wnd, res->ctx)) {
+            set_error("(standalone) glXMakeCurrent failed");
+            return false;
+        }
+
+        return true;
+    }
+
+    set_error("unknown mode");
+    return false;
+}
+
+void release_context(X11BackendContext * self) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    if (!self->ctx) {
+        return;
+    }
+    bool bound_elsewhere = false;
+    if (self->is_standalone) {
+        if (get_current(self->lib).ctx == self->ctx) {
+            make_current(self->lib, self->dpy, None, NULL);
+        }
+        // a context still current on another thread is destroyed, the driver frees it once that thread unbinds it
+        bound_elsewhere = bound_on_any_thread(self->ctx);
+        if (!bound_elsewhere && recycle_context(self)) {
+            self->dpy = NULL;
+            self->ctx = NULL;
+            self->fbc = NULL;
+            self->vi = NULL;
+            return;
+        }
+        remove_share_group_member(self->group, self->ctx);
+        self->lib->m_glXDestroyContext(self->dpy, self->ctx);
+        self->ctx = NULL;
+    }
+    if (self->own_window) {
+        // another thread still unbinds the context through the display, the connection is left open for it
+        if (!bound_elsewhere) {
+            self->lib->m_XDestroyWindow(self->dpy, self->wnd);
+            self->lib->m_XCloseDisplay(self->dpy);
+        }
+        self->dpy = NULL;
+    }
+    if (self->fbc) {
+        self->lib->m_XFree(self->fbc);
+        self->fbc = NULL;
+    }
+    if (self->vi) {
+        self->lib->m_XFree(self->vi);
+        self->vi = NULL;
+    }
+}
+
+void free_context(X11BackendContext * self) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    release_library(self->lib);
+    self->lib = NULL;
+}
+
+void * load_proc(X11BackendContext * self, const char * method) {
+    std::lock_guard<std::mutex> guard(self->lib->procs_lock);
+    SymbolCache::iterator it = self->lib->procs.find(method);
+    if (it != self->lib->procs.end()) {
+        return it->second;
+    }
+    void * proc = (void *)dlsym(self->lib->libgl, method);
+    if (!proc) {
+        proc = (void *)self->lib->m_glXGetProcAddress((const unsigned char *)method);
+    }
+    self->lib->procs.emplace(method, proc);
+    return proc;
+}
+
+X11BackendContext::~X11BackendContext() {
+    // A context that was never released keeps its libraries loaded
+    if (lib && (!is_standalone || !ctx)) {
+        free_context(this);
+    }
+}
+
+bool X11BackendContext::enter() {
+    // a failed enter() keeps the current binding and pushes nothing, there is no matching exit()
+    if (!ctx) {
+        set_error("the context was released");
+        return false;
+    }
+    Binding & current = get_current(lib);
+    Binding previous = current;
+    if (!switch_binding(lib, current, dpy, wnd, ctx)) {
+        set_error("glXMakeCurrent failed");
+        return false;
+    }
+    binding_stack.push_back(previous);
+    run_pending_deletions(group);
+    return true;
+}
+
+bool X11BackendContext::exit() {
+    Binding & current = get_current(lib);
+    // the display of a released standalone context is closed or pooled, the current binding is dropped through its own display
+    Display * unbind_dpy = dpy ? dpy : current.dpy;
+    if (binding_stack.empty()) {
+        return switch_binding(lib, current, unbind_dpy, None, NULL);
+    }
+    Binding previous = binding_stack.back();
+    binding_stack.pop_back();
+    if (previous.ctx) {
+        return switch_binding(lib, current, previous.dpy, previous.wnd, previous.ctx);
+    }
+    return switch_binding(lib, current, unbind_dpy, None, NULL);
+}
+
+bool X11BackendContext::enter_changes_binding() {
+    return !is_current(lib, dpy, wnd, ctx);
+}
+
+bool X11BackendContext::exit_changes_binding() {
+    if (binding_stack.empty() || !binding_stack.back().ctx) {
+        return !is_current(lib, dpy, None, NULL);
+    }
+    const Binding & previous = binding_stack.back();
+    return !is_current(lib, previous.dpy, previous.wnd, previous.ctx);
+}
+
+void * X11BackendContext::load(const char * name) {
+    return load_proc(this, name);
+}
+
+void X11BackendContext::release() {
+    release_context(this);
+}
+
+bool X11BackendContext::standalone() {
+    return is_standalone;
+}
+
+void * X11BackendContext::current_native() {
+    return lib->m_glXGetCurrentContext();
+}
+
+bool X11BackendContext::no_error() {
+    return is_no_error;
+}
+
+int X11BackendContext::release_behavior() {
+    return release_mode;
+}
+
+Fence * X11BackendContext::fence() {
+    return create_gl_fence(this);
+}
+
+}
+
+Context * create_x11_context(const char * mode, const char * libgl, const char * libx11, int glversion, const ContextOptions * options) {
+    X11BackendContext * res = new X11BackendContext();
+    if (!create_context(res, mode, libgl, libx11, glversion, options)) {
+        delete res;
+        return NULL;
+    }
+    // contexts from the pool keep their group, x11 contexts only share with contexts created elsewhere
+    if (!res->group) {
+        res->group = retain_share_group(NULL);
+        add_share_group_member(res->group, res->ctx);
+    }
+    return res;
+}
+
+void configure_x11_pool(int max_size, double max_idle) {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    pool.max_size = max_size;
+    pool.max_idle = max_idle;
+    evict_pooled_contexts(max_size);
+}
+
+PoolStats x11_pool_stats() {
+    std::lock_guard<std::mutex> guard(registry_lock);
+    evict_pooled_contexts(pool.max_size);
+    PoolStats stats;
+    stats.size = (int)pool.entries.size();
+    stats.max_size = pool.max_size;
+    stats.hits = pool.hits;
+    stats.misses = pool.misses;
+    stats.evictions = pool.evictions;
+    return stats;
+}
+
+}
+
+glcontext_context * glcontext_create_x11(const char * mode, const char * libgl, const char * libx11, int glversion) {
+    return (glcontext_context *)glcontext::create_x11_context(mode ? mode : "detect", libgl, libx11, glversion, NULL);
+}
+
+glcontext_context * glcontext_create_x11_ex(const char * mode, const char * libgl, const char * libx11, int glversion, const glcontext_options * options) {
+    return (glcontext_context *)glcontext::create_x11_context(mode ? mode : "detect", libgl, libx11, glversion, options);
+}
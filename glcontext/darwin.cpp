@@ -11,13 +11,17 @@
 #include <OpenGL/gl.h>
 #include <OpenGL/glext.h>
 
+#include <vector>
+
 struct GLContext {
     PyObject_HEAD
     CGLContextObj ctx;
     int standalone;
-    void * old_context;
 };
 
+// The contexts to restore when leaving nested with blocks on the calling thread.
+thread_local std::vector<CGLContextObj> context_stack;
+
 PyTypeObject * GLContext_type;
 
 GLContext * meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
@@ -112,13 +116,19 @@ PyObject * GLContext_meth_load(GLContext * self, PyObject * arg) {
 }
 
 PyObject * GLContext_meth_enter(GLContext * self) {
-    self->old_context = (void *)CGLGetCurrentContext();
+    context_stack.push_back(CGLGetCurrentContext());
     CGLSetCurrentContext(self->ctx);
     Py_RETURN_NONE;
 }
 
-PyObject * GLContext_meth_exit(GLContext * self) {
-    CGLSetCurrentContext((CGLContextObj)self->old_context);
+PyObject * GLContext_meth_exit(GLContext * self, PyObject * const * args, Py_ssize_t nargs) {
+    if (context_stack.empty()) {
+        CGLSetCurrentContext(NULL);
+        Py_RETURN_NONE;
+    }
+    CGLContextObj previous = context_stack.back();
+    context_stack.pop_back();
+    CGLSetCurrentContext(previous);
     Py_RETURN_NONE;
 }
 
@@ -139,7 +149,7 @@ PyMethodDef GLContext_methods[] = {
     {"load_opengl_function", (PyCFunction)GLContext_meth_load, METH_O, NULL},
     {"release", (PyCFunction)GLContext_meth_release, METH_NOARGS, NULL},
     {"__enter__", (PyCFunction)GLContext_meth_enter, METH_NOARGS, NULL},
-    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_VARARGS, NULL},
+    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_FASTCALL, NULL},
     {},
 };
 
@@ -1,398 +1,766 @@
 #include <Python.h>
 #include <structmember.h>
 
-#include <dlfcn.h>
-
-struct Display;
-
-typedef unsigned int EGLenum;
-typedef int EGLint;
-typedef unsigned int EGLBoolean;
-typedef Display * EGLNativeDisplayType;
-typedef void * EGLConfig;
-typedef void * EGLSurface;
-typedef void * EGLContext;
-typedef void * EGLDeviceEXT;
-typedef void * EGLDisplay;
-
-
-#define EGL_DEFAULT_DISPLAY 0
-#define EGL_NO_CONTEXT 0
-#define EGL_NO_SURFACE 0
-#define EGL_NO_DISPLAY 0
-#define EGL_PBUFFER_BIT 0x0001
-#define EGL_WINDOW_BIT 0x0004
-#define EGL_RENDERABLE_TYPE 0x3040
-#define EGL_NONE 0x3038
-#define EGL_OPENGL_BIT 0x0008
-#define EGL_BLUE_SIZE 0x3022
-#define EGL_DEPTH_SIZE 0x3025
-#define EGL_RED_SIZE 0x3024
-#define EGL_GREEN_SIZE 0x3023
-#define EGL_SURFACE_TYPE 0x3033
-#define EGL_OPENGL_API 0x30A2
-#define EGL_WIDTH 0x3057
-#define EGL_HEIGHT 0x3056
-#define EGL_SUCCESS 0x3000
-#define EGL_CONTEXT_MAJOR_VERSION 0x3098
-#define EGL_CONTEXT_MINOR_VERSION 0x30FB
-#define EGL_CONTEXT_OPENGL_PROFILE_MASK 0x30FD
-#define EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT 0x00000001
-#define EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE 0x31B1
-#define EGL_PLATFORM_DEVICE_EXT 0x313F
-#define EGL_PLATFORM_WAYLAND_EXT 0x31D8
-#define EGL_PLATFORM_X11_EXT 0x31D5
-#define EGL_DRAW 0x3059
-#define EGL_READ 0x305A
-
-typedef EGLint (* m_eglGetErrorProc)();
-typedef EGLDisplay (* m_eglGetDisplayProc)(EGLNativeDisplayType);
-typedef EGLBoolean (* m_eglInitializeProc)(EGLDisplay, EGLint *, EGLint *);
-typedef EGLBoolean (* m_eglChooseConfigProc)(EGLDisplay, const EGLint *, EGLConfig *, EGLint, EGLint *);
-typedef EGLBoolean (* m_eglBindAPIProc)(EGLenum);
-typedef EGLContext (* m_eglCreateContextProc)(EGLDisplay, EGLConfig, EGLContext, const EGLint *);
-typedef EGLBoolean (* m_eglDestroyContextProc)(EGLDisplay, EGLContext);
-typedef EGLBoolean (* m_eglMakeCurrentProc)(EGLDisplay, EGLSurface, EGLSurface, EGLContext);
-typedef void (* (* m_eglGetProcAddressProc)(const char *))();
-typedef EGLBoolean (* m_eglQueryDevicesEXTProc)(EGLint, EGLDeviceEXT *, EGLint *);
-typedef EGLDisplay (* m_eglGetPlatformDisplayEXTProc) (EGLenum, void *, const EGLint *);
-typedef EGLContext (* m_eglGetCurrentContextProc) (void);	 
-typedef EGLSurface (* m_eglGetCurrentSurfaceProc ) (EGLint readdraw);
-typedef EGLDisplay (* m_eglGetCurrentDisplayProc )(void);	
+#include <cstring>
+#include <vector>
+
+#include "glcontext.hpp"
+#include "core/context.hpp"
 
 struct GLContext {
     PyObject_HEAD
 
-    void * libgl;
-    void * libegl;
-    EGLContext ctx;
-    EGLDisplay dpy;
-    EGLConfig cfg;
-    EGLSurface wnd;
-
+    glcontext::Context * context;
     int standalone;
+    int no_error;
+};
+
+struct Fence {
+    PyObject_HEAD
+
+    glcontext::Fence * fence;
+    PyObject * context;
+};
+
+struct FramePacer {
+    PyObject_HEAD
 
-    m_eglGetErrorProc m_eglGetError;
-    m_eglGetDisplayProc m_eglGetDisplay;
-    m_eglInitializeProc m_eglInitialize;
-    m_eglChooseConfigProc m_eglChooseConfig;
-    m_eglBindAPIProc m_eglBindAPI;
-    m_eglCreateContextProc m_eglCreateContext;
-    m_eglDestroyContextProc m_eglDestroyContext;
-    m_eglMakeCurrentProc m_eglMakeCurrent;
-    m_eglGetProcAddressProc m_eglGetProcAddress;
-    m_eglQueryDevicesEXTProc m_eglQueryDevicesEXT;
-    m_eglGetPlatformDisplayEXTProc m_eglGetPlatformDisplayEXT;
-    m_eglGetCurrentContextProc m_eglGetCurrentContext;
-    m_eglGetCurrentSurfaceProc m_eglGetCurrentSurface;
-    m_eglGetCurrentDisplayProc m_eglGetCurrentDisplay;
+    glcontext::FramePacer * pacer;
+    PyObject * context;
+    int frames;
 };
 
 PyTypeObject * GLContext_type;
+PyTypeObject * Fence_type;
+PyTypeObject * FramePacer_type;
+PyObject * array_type;
+PyObject * wait_fence;
+PyObject * default_devices;
+
+struct ConfigAttribName {
+    const char * name;
+    int attrib;
+};
 
-GLContext * meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {"mode", "libgl", "libegl", "glversion", "device_index", NULL};
+#define CONFIG_ATTRIB_END 0x3038
+
+ConfigAttribName config_attrib_names[] = {
+    {"red_size", 0x3024},
+    {"green_size", 0x3023},
+    {"blue_size", 0x3022},
+    {"alpha_size", 0x3021},
+    {"depth_size", 0x3025},
+    {"stencil_size", 0x3026},
+    {"samples", 0x3031},
+    {"sample_buffers", 0x3032},
+    {},
+};
 
-    const char * mode = "standalone";
-    const char * libgl = "libGL.so";
-    const char * libegl = "libEGL.so";
-    int glversion = 330;
-    int device_index = 0;
+// config is None for the default config, "none" for a context without a config or a dict of framebuffer sizes.
+// The sizes are minimums, the matching config with the smallest default framebuffer is selected.
+bool parse_config(PyObject * config, std::vector<int> & attribs, glcontext::ContextOptions * options) {
+    if (!config || config == Py_None) {
+        return true;
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sssii", keywords, &mode, &libgl, &libegl, &glversion, &device_index)) {
-        return NULL;
+    if (PyUnicode_Check(config) && !PyUnicode_CompareWithASCIIString(config, "none")) {
+        options->no_config = true;
+        return true;
     }
 
-    GLContext * res = PyObject_New(GLContext, GLContext_type);
+    if (!PyDict_Check(config)) {
+        PyErr_Format(PyExc_TypeError, "config must be None, 'none' or a dict");
+        return false;
+    }
 
-    res->libgl = dlopen(libgl, RTLD_LAZY);
-    if (!res->libgl) {
-        PyErr_Format(PyExc_Exception, "%s not loaded", libgl);
-        return NULL;
+    PyObject * key;
+    PyObject * value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(config, &pos, &key, &value)) {
+        const char * name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+        int attrib = 0;
+        for (int i = 0; name && config_attrib_names[i].name; ++i) {
+            if (!strcmp(config_attrib_names[i].name, name)) {
+                attrib = config_attrib_names[i].attrib;
+            }
+        }
+        if (!attrib) {
+            PyErr_Format(PyExc_KeyError, "unknown config attribute %R", key);
+            return false;
+        }
+        int size = PyLong_AsLong(value);
+        if (PyErr_Occurred()) {
+            return false;
+        }
+        attribs.push_back(attrib);
+        attribs.push_back(size);
     }
 
-    res->libegl = dlopen(libegl, RTLD_LAZY);
-    if (!res->libegl) {
-        PyErr_Format(PyExc_Exception, "%s not loaded", libegl);
-        return NULL;
+    attribs.push_back(CONFIG_ATTRIB_END);
+    options->config_attribs = attribs.data();
+    return true;
+}
+
+bool parse_release_behavior(const char * release_behavior, glcontext::ContextOptions * options) {
+    if (!strcmp(release_behavior, "flush")) {
+        options->release_behavior = GLCONTEXT_RELEASE_FLUSH;
+        return true;
+    }
+    if (!strcmp(release_behavior, "none")) {
+        options->release_behavior = GLCONTEXT_RELEASE_NONE;
+        return true;
     }
+    PyErr_Format(PyExc_ValueError, "release_behavior must be 'flush' or 'none'");
+    return false;
+}
 
-    res->m_eglGetError = (m_eglGetErrorProc)dlsym(res->libegl, "eglGetError");
-    if (!res->m_eglGetError) {
-        PyErr_Format(PyExc_Exception, "eglGetError not found");
-        return NULL;
+// device_index is an int or "auto" to let the backend place the context with the placement policy.
+bool parse_device_index(PyObject * device_index_arg, const char * placement, int * device_index) {
+    if (!PyUnicode_Check(device_index_arg)) {
+        *device_index = PyLong_AsLong(device_index_arg);
+        if (PyErr_Occurred()) {
+            return false;
+        }
+        if (*device_index < 0) {
+            PyErr_Format(PyExc_ValueError, "device_index must not be negative");
+            return false;
+        }
+        return true;
     }
 
-    res->m_eglGetDisplay = (m_eglGetDisplayProc)dlsym(res->libegl, "eglGetDisplay");
-    if (!res->m_eglGetDisplay) {
-        PyErr_Format(PyExc_Exception, "eglGetDisplay not found");
-        return NULL;
+    if (PyUnicode_CompareWithASCIIString(device_index_arg, "auto")) {
+        PyErr_Format(PyExc_ValueError, "device_index must be an int or 'auto'");
+        return false;
     }
 
-    res->m_eglInitialize = (m_eglInitializeProc)dlsym(res->libegl, "eglInitialize");
-    if (!res->m_eglInitialize) {
-        PyErr_Format(PyExc_Exception, "eglInitialize not found");
-        return NULL;
+    if (!strcmp(placement, "round_robin")) {
+        *device_index = glcontext::DEVICE_ROUND_ROBIN;
+    } else if (!strcmp(placement, "least_contexts")) {
+        *device_index = glcontext::DEVICE_LEAST_CONTEXTS;
+    } else if (!strcmp(placement, "prefer_hardware")) {
+        *device_index = glcontext::DEVICE_PREFER_HARDWARE;
+    } else {
+        PyErr_Format(PyExc_ValueError, "placement must be 'round_robin', 'least_contexts' or 'prefer_hardware'");
+        return false;
     }
+    return true;
+}
 
-    res->m_eglChooseConfig = (m_eglChooseConfigProc)dlsym(res->libegl, "eglChooseConfig");
-    if (!res->m_eglChooseConfig) {
-        PyErr_Format(PyExc_Exception, "eglChooseConfig not found");
+GLContext * meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"mode", "libgl", "libegl", "glversion", "device_index", "share", "placement", "config", "no_error", "release_behavior", NULL};
+
+    const char * mode = "standalone";
+    const char * libgl = NULL;
+    const char * libegl = NULL;
+    int glversion = 330;
+    PyObject * device_index_arg = NULL;
+    GLContext * share = NULL;
+    const char * placement = "least_contexts";
+    PyObject * config = NULL;
+    int no_error = false;
+    const char * release_behavior = "flush";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sssiOO!sOps", keywords, &mode, &libgl, &libegl, &glversion, &device_index_arg, GLContext_type, &share, &placement, &config, &no_error, &release_behavior)) {
         return NULL;
     }
 
-    res->m_eglBindAPI = (m_eglBindAPIProc)dlsym(res->libegl, "eglBindAPI");
-    if (!res->m_eglBindAPI) {
-        PyErr_Format(PyExc_Exception, "eglBindAPI not found");
+    int device_index = 0;
+    if (device_index_arg && !parse_device_index(device_index_arg, placement, &device_index)) {
         return NULL;
     }
 
-    res->m_eglCreateContext = (m_eglCreateContextProc)dlsym(res->libegl, "eglCreateContext");
-    if (!res->m_eglCreateContext) {
-        PyErr_Format(PyExc_Exception, "eglCreateContext not found");
+    std::vector<int> config_attribs;
+    glcontext::ContextOptions options = {};
+    options.no_error = no_error;
+    if (!parse_config(config, config_attribs, &options) || !parse_release_behavior(release_behavior, &options)) {
         return NULL;
     }
 
-    res->m_eglDestroyContext = (m_eglDestroyContextProc)dlsym(res->libegl, "eglDestroyContext");
-    if (!res->m_eglDestroyContext) {
-        PyErr_Format(PyExc_Exception, "eglDestroyContext not found");
+    glcontext::Context * context;
+    Py_BEGIN_ALLOW_THREADS
+    context = glcontext::create_egl_context(mode, libgl, libegl, glversion, device_index, share ? share->context : NULL, &options);
+    Py_END_ALLOW_THREADS
+
+    if (!context) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
         return NULL;
     }
 
-    res->m_eglMakeCurrent = (m_eglMakeCurrentProc)dlsym(res->libegl, "eglMakeCurrent");
-    if (!res->m_eglMakeCurrent) {
-        PyErr_Format(PyExc_Exception, "eglMakeCurrent not found");
+    GLContext * res = PyObject_New(GLContext, GLContext_type);
+    res->context = context;
+    res->standalone = context->standalone();
+    res->no_error = context->no_error();
+    return res;
+}
+
+PyObject * meth_create_share_group(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"count", "libgl", "libegl", "glversion", "device_index", "placement", "config", "no_error", "release_behavior", NULL};
+
+    int count = 0;
+    const char * libgl = NULL;
+    const char * libegl = NULL;
+    int glversion = 330;
+    PyObject * device_index_arg = NULL;
+    const char * placement = "least_contexts";
+    PyObject * config = NULL;
+    int no_error = false;
+    const char * release_behavior = "flush";
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|ssiOsOps", keywords, &count, &libgl, &libegl, &glversion, &device_index_arg, &placement, &config, &no_error, &release_behavior)) {
         return NULL;
     }
 
-    res->m_eglGetProcAddress = (m_eglGetProcAddressProc)dlsym(res->libegl, "eglGetProcAddress");
-    if (!res->m_eglGetProcAddress) {
-        PyErr_Format(PyExc_Exception, "eglGetProcAddress not found");
+    int device_index = 0;
+    if (device_index_arg && !parse_device_index(device_index_arg, placement, &device_index)) {
         return NULL;
     }
 
-    res->m_eglQueryDevicesEXT = (m_eglQueryDevicesEXTProc)res->m_eglGetProcAddress("eglQueryDevicesEXT");
-    if (!res->m_eglQueryDevicesEXT) {
-        PyErr_Format(PyExc_Exception, "eglQueryDevicesEXT not found");
+    std::vector<int> config_attribs;
+    glcontext::ContextOptions options = {};
+    options.no_error = no_error;
+    if (!parse_config(config, config_attribs, &options) || !parse_release_behavior(release_behavior, &options)) {
         return NULL;
     }
 
-    res->m_eglGetPlatformDisplayEXT = (m_eglGetPlatformDisplayEXTProc)res->m_eglGetProcAddress("eglGetPlatformDisplayEXT");
-    if (!res->m_eglGetPlatformDisplayEXT) {
-        PyErr_Format(PyExc_Exception, "eglGetPlatformDisplayEXT not found");
+    if (count < 1) {
+        PyErr_Format(PyExc_ValueError, "count must be at least 1");
         return NULL;
     }
 
-    res->m_eglGetCurrentDisplay = (m_eglGetCurrentDisplayProc)res->m_eglGetProcAddress("eglGetCurrentDisplay");
-    if (!res->m_eglGetCurrentDisplay) {
-        PyErr_Format(PyExc_Exception, "eglGetCurrentDisplay not found");
+    std::vector<glcontext::Context *> contexts(count);
+
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = glcontext::create_egl_share_group(count, libgl, libegl, glversion, device_index, &options, contexts.data());
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
         return NULL;
     }
 
-    res->m_eglGetCurrentContext = (m_eglGetCurrentContextProc)res->m_eglGetProcAddress("eglGetCurrentContext");
-    if (!res->m_eglGetCurrentContext) {
-        PyErr_Format(PyExc_Exception, "eglGetCurrentContext not found");
-        return NULL;
+    PyObject * res = PyTuple_New(count);
+    for (int i = 0; i < count; ++i) {
+        GLContext * context = PyObject_New(GLContext, GLContext_type);
+        context->context = contexts[i];
+        context->standalone = true;
+        context->no_error = contexts[i]->no_error();
+        PyTuple_SET_ITEM(res, i, (PyObject *)context);
     }
+    return res;
+}
 
-    res->m_eglGetCurrentSurface = (m_eglGetCurrentSurfaceProc)res->m_eglGetProcAddress("eglGetCurrentSurface");
-    if (!res->m_eglGetCurrentSurface) {
-        PyErr_Format(PyExc_Exception, "eglGetCurrentSurfaceProc not found");
+PyObject * GLContext_meth_load(GLContext * self, PyObject * arg) {
+    const char * method = PyUnicode_AsUTF8(arg);
+    if (!method) {
         return NULL;
     }
+    return PyLong_FromVoidPtr(self->context->load(method));
+}
 
-    if (!strcmp(mode, "standalone")) {
-        res->standalone = true;
-        res->wnd = EGL_NO_SURFACE;
+PyObject * GLContext_meth_load_many(GLContext * self, PyObject * arg) {
+    PyObject * names = PySequence_Fast(arg, "load_many() expects a sequence of names");
+    if (!names) {
+        return NULL;
+    }
 
-        EGLint num_devices;
-        if (!res->m_eglQueryDevicesEXT(0, NULL, &num_devices)) {
-            PyErr_Format(PyExc_Exception, "eglQueryDevicesEXT failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(names);
+    PyObject * data = PyBytes_FromStringAndSize(NULL, count * sizeof(unsigned long long));
+    if (!data) {
+        Py_DECREF(names);
+        return NULL;
+    }
 
-        if (device_index >= num_devices) {
-            PyErr_Format(PyExc_Exception, "requested device index %d, but found %d devices", device_index, num_devices);
+    unsigned long long * procs = (unsigned long long *)PyBytes_AS_STRING(data);
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        const char * method = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(names, i));
+        if (!method) {
+            Py_DECREF(names);
+            Py_DECREF(data);
             return NULL;
         }
+        procs[i] = (unsigned long long)(size_t)self->context->load(method);
+    }
 
-        EGLDeviceEXT * devices = (EGLDeviceEXT *)malloc(sizeof(EGLDeviceEXT) * num_devices);
-        if (!res->m_eglQueryDevicesEXT(num_devices, devices, &num_devices)) {
-            PyErr_Format(PyExc_Exception, "eglQueryDevicesEXT failed (0x%x)", res->m_eglGetError());
-            free(devices);
-            return NULL;
-        }
-        EGLDeviceEXT device = devices[device_index];
-        free(devices);
+    Py_DECREF(names);
+    return PyObject_CallFunction(array_type, "sN", "Q", data);
+}
 
-        res->dpy = res->m_eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, device, 0);
-        if (res->dpy == EGL_NO_DISPLAY) {
-            PyErr_Format(PyExc_Exception, "eglGetPlatformDisplayEXT failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+// The GIL is only released when the driver has to be called, bindings that are already current return right away.
+// A failed enter() pushes no binding, __exit__ is not called when __enter__ raises.
+PyObject * GLContext_meth_enter(GLContext * self) {
+    bool success;
+    if (!self->context->enter_changes_binding()) {
+        success = self->context->enter();
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        success = self->context->enter();
+        Py_END_ALLOW_THREADS
+    }
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
-        EGLint major, minor;
-        if (!res->m_eglInitialize(res->dpy, &major, &minor)) {
-            PyErr_Format(PyExc_Exception, "eglInitialize failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+PyObject * GLContext_meth_exit(GLContext * self, PyObject * const * args, Py_ssize_t nargs) {
+    if (!self->context->exit_changes_binding()) {
+        self->context->exit();
+        Py_RETURN_NONE;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    self->context->exit();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
 
-        EGLint config_attribs[] = {
-            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
-            EGL_BLUE_SIZE, 8,
-            EGL_GREEN_SIZE, 8,
-            EGL_RED_SIZE, 8,
-            EGL_DEPTH_SIZE, 8,
-            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
-            EGL_NONE
-        };
-
-        EGLint num_configs = 0;
-        if (!res->m_eglChooseConfig(res->dpy, config_attribs, &res->cfg, 1, &num_configs)) {
-            PyErr_Format(PyExc_Exception, "eglChooseConfig failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+PyObject * GLContext_meth_fence(GLContext * self) {
+    glcontext::Fence * fence;
+    Py_BEGIN_ALLOW_THREADS
+    fence = self->context->fence();
+    Py_END_ALLOW_THREADS
 
-        if (!res->m_eglBindAPI(EGL_OPENGL_API)) {
-            PyErr_Format(PyExc_Exception, "eglBindAPI failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+    if (!fence) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
 
-        int ctxattribs[] = {
-            EGL_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
-            EGL_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
-            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
-            // EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, 1,
-            EGL_NONE,
-        };
-
-        res->ctx = res->m_eglCreateContext(res->dpy, res->cfg, EGL_NO_CONTEXT, ctxattribs);
-        if (!res->ctx) {
-            PyErr_Format(PyExc_Exception, "eglCreateContext failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+    Fence * res = PyObject_New(Fence, Fence_type);
+    res->fence = fence;
+    Py_INCREF(self);
+    res->context = (PyObject *)self;
+    return (PyObject *)res;
+}
 
-        res->m_eglMakeCurrent(res->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, res->ctx);
-        return res;
+// The fence is waited on by a single thread in glcontext.waiter, the returned future belongs to the running event loop.
+// OpenGL sync objects can only be waited on with a context of the share group current, the waiter thread has none.
+PyObject * GLContext_meth_gpu_done(GLContext * self) {
+    if (!glcontext::egl_fence_sync_supported(self->context)) {
+        PyErr_SetString(PyExc_Exception, "EGL_KHR_fence_sync is not supported");
+        return NULL;
     }
 
-    if (!strcmp(mode, "share")) {
-        res->standalone = false;
-
-        EGLContext ctx_share = res->m_eglGetCurrentContext();
-        if (!ctx_share) {
-            PyErr_Format(PyExc_Exception, "(share) eglGetCurrentContext: cannot detect OpenGL context");
+    if (!wait_fence) {
+        PyObject * waiter = PyImport_ImportModule("glcontext.waiter");
+        if (!waiter) {
             return NULL;
         }
-
-        res->wnd = res->m_eglGetCurrentSurface(EGL_DRAW);
-        if (!res->wnd) {
-            PyErr_Format(PyExc_Exception, "(share) m_eglGetCurrentSurface failed (0x%x)", res->m_eglGetError());
+        wait_fence = PyObject_GetAttrString(waiter, "wait_fence");
+        Py_DECREF(waiter);
+        if (!wait_fence) {
             return NULL;
         }
+    }
 
-        res->dpy = res->m_eglGetCurrentDisplay();
-        if (res->dpy == EGL_NO_DISPLAY) {
-            PyErr_Format(PyExc_Exception, "eglGetCurrentDisplay failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+    PyObject * fence = GLContext_meth_fence(self);
+    if (!fence) {
+        return NULL;
+    }
 
-        EGLint config_attribs[] = {
-            EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
-            EGL_BLUE_SIZE, 8,
-            EGL_GREEN_SIZE, 8,
-            EGL_RED_SIZE, 8,
-            EGL_DEPTH_SIZE, 24,
-            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
-            EGL_NONE
-        };
-
-        EGLint num_configs = 0;
-        if (!res->m_eglChooseConfig(res->dpy, config_attribs, &res->cfg, 1, &num_configs)) {
-            PyErr_Format(PyExc_Exception, "eglChooseConfig failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+    PyObject * res = PyObject_CallFunctionObjArgs(wait_fence, fence, NULL);
+    Py_DECREF(fence);
+    return res;
+}
 
-        if (!res->m_eglBindAPI(EGL_OPENGL_API)) {
-            PyErr_Format(PyExc_Exception, "eglBindAPI failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+PyObject * GLContext_meth_frame_pacer(GLContext * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"frames", NULL};
 
-        int ctxattribs[] = {
-            EGL_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
-            EGL_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
-            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
-            // EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE, 1,
-            EGL_NONE,
-        };
-
-        res->ctx = res->m_eglCreateContext(res->dpy, res->cfg, ctx_share, ctxattribs);
-        if (!res->ctx) {
-            PyErr_Format(PyExc_Exception, "eglCreateContext failed (0x%x)", res->m_eglGetError());
-            return NULL;
-        }
+    int frames = 2;
 
-        res->m_eglMakeCurrent(res->dpy, res->wnd, res->wnd, res->ctx);
-        return res;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i", keywords, &frames)) {
+        return NULL;
     }
 
-    PyErr_Format(PyExc_Exception, "unknown mode");
-    return NULL;
-}
-
-PyObject * GLContext_meth_load(GLContext * self, PyObject * arg) {
-    const char * method = PyUnicode_AsUTF8(arg);
-    void * proc = (void *)dlsym(self->libgl, method);
-    if (!proc) {
-        proc = (void *)self->m_eglGetProcAddress(method);
+    if (frames < 1) {
+        PyErr_Format(PyExc_ValueError, "frames must be at least 1");
+        return NULL;
     }
-    return PyLong_FromVoidPtr(proc);
-}
-
-PyObject * GLContext_meth_enter(GLContext * self) {
-    self->m_eglMakeCurrent(self->dpy, self->wnd, self->wnd, self->ctx);
-    Py_RETURN_NONE;
-}
 
-PyObject * GLContext_meth_exit(GLContext * self) {
-    self->m_eglMakeCurrent(self->dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
-    Py_RETURN_NONE;
+    FramePacer * res = PyObject_New(FramePacer, FramePacer_type);
+    res->pacer = new glcontext::FramePacer(self->context, frames);
+    Py_INCREF(self);
+    res->context = (PyObject *)self;
+    res->frames = frames;
+    return (PyObject *)res;
 }
 
 PyObject * GLContext_meth_release(GLContext * self) {
-    self->m_eglDestroyContext(self->dpy, self->ctx);
+    Py_BEGIN_ALLOW_THREADS
+    self->context->release();
+    Py_END_ALLOW_THREADS
     Py_RETURN_NONE;
 }
 
 void GLContext_dealloc(GLContext * self) {
+    Py_BEGIN_ALLOW_THREADS
+    delete self->context;
+    Py_END_ALLOW_THREADS
     Py_TYPE(self)->tp_free(self);
 }
 
 PyMethodDef GLContext_methods[] = {
     {"load", (PyCFunction)GLContext_meth_load, METH_O, NULL},
     {"load_opengl_function", (PyCFunction)GLContext_meth_load, METH_O, NULL},
+    {"load_many", (PyCFunction)GLContext_meth_load_many, METH_O, NULL},
+    {"fence", (PyCFunction)GLContext_meth_fence, METH_NOARGS, NULL},
+    {"frame_pacer", (PyCFunction)GLContext_meth_frame_pacer, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"gpu_done", (PyCFunction)GLContext_meth_gpu_done, METH_NOARGS, NULL},
     {"release", (PyCFunction)GLContext_meth_release, METH_NOARGS, NULL},
     {"__enter__", (PyCFunction)GLContext_meth_enter, METH_NOARGS, NULL},
-    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_VARARGS, NULL},
+    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_FASTCALL, NULL},
     {},
 };
 
+PyObject * GLContext_get_release_behavior(GLContext * self, void * closure) {
+    return PyUnicode_FromString(self->context->release_behavior() == GLCONTEXT_RELEASE_NONE ? "none" : "flush");
+}
+
 PyMemberDef GLContext_members[] = {
     {"standalone", T_BOOL, offsetof(GLContext, standalone), READONLY, NULL},
+    {"no_error", T_BOOL, offsetof(GLContext, no_error), READONLY, NULL},
+    {},
+};
+
+PyGetSetDef GLContext_getset[] = {
+    {"release_behavior", (getter)GLContext_get_release_behavior, NULL, NULL, NULL},
     {},
 };
 
 PyType_Slot GLContext_slots[] = {
     {Py_tp_methods, GLContext_methods},
     {Py_tp_members, GLContext_members},
+    {Py_tp_getset, GLContext_getset},
     {Py_tp_dealloc, (void *)GLContext_dealloc},
     {},
 };
 
 PyType_Spec GLContext_spec = {"egl.GLContext", sizeof(GLContext), 0, Py_TPFLAGS_DEFAULT, GLContext_slots};
 
+PyObject * Fence_meth_client_wait(Fence * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"timeout", NULL};
+
+    PyObject * timeout_arg = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keywords, &timeout_arg)) {
+        return NULL;
+    }
+
+    double timeout = -1.0;
+    if (timeout_arg != Py_None) {
+        timeout = PyFloat_AsDouble(timeout_arg);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = self->fence->client_wait(timeout);
+    Py_END_ALLOW_THREADS
+
+    if (status < 0) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    return PyBool_FromLong(status);
+}
+
+PyObject * Fence_meth_server_wait(Fence * self) {
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = self->fence->server_wait();
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+void Fence_dealloc(Fence * self) {
+    Py_BEGIN_ALLOW_THREADS
+    delete self->fence;
+    Py_END_ALLOW_THREADS
+    Py_DECREF(self->context);
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyMethodDef Fence_methods[] = {
+    {"client_wait", (PyCFunction)Fence_meth_client_wait, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"server_wait", (PyCFunction)Fence_meth_server_wait, METH_NOARGS, NULL},
+    {},
+};
+
+PyMemberDef Fence_members[] = {
+    {"context", T_OBJECT_EX, offsetof(Fence, context), READONLY, NULL},
+    {},
+};
+
+PyType_Slot Fence_slots[] = {
+    {Py_tp_methods, Fence_methods},
+    {Py_tp_members, Fence_members},
+    {Py_tp_dealloc, (void *)Fence_dealloc},
+    {},
+};
+
+PyType_Spec Fence_spec = {"egl.Fence", sizeof(Fence), 0, Py_TPFLAGS_DEFAULT, Fence_slots};
+
+PyObject * FramePacer_meth_begin_frame(FramePacer * self) {
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = self->pacer->begin_frame();
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject * FramePacer_meth_end_frame(FramePacer * self) {
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = self->pacer->end_frame();
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// A frame that raised inside the with block is still fenced, the commands it submitted count against the limit.
+PyObject * FramePacer_meth_exit(FramePacer * self, PyObject * const * args, Py_ssize_t nargs) {
+    return FramePacer_meth_end_frame(self);
+}
+
+PyObject * FramePacer_get_frames_in_flight(FramePacer * self, void * closure) {
+    int frames;
+    Py_BEGIN_ALLOW_THREADS
+    frames = self->pacer->frames_in_flight();
+    Py_END_ALLOW_THREADS
+    return PyLong_FromLong(frames);
+}
+
+void FramePacer_dealloc(FramePacer * self) {
+    Py_BEGIN_ALLOW_THREADS
+    delete self->pacer;
+    Py_END_ALLOW_THREADS
+    Py_DECREF(self->context);
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyMethodDef FramePacer_methods[] = {
+    {"begin_frame", (PyCFunction)FramePacer_meth_begin_frame, METH_NOARGS, NULL},
+    {"end_frame", (PyCFunction)FramePacer_meth_end_frame, METH_NOARGS, NULL},
+    {"__enter__", (PyCFunction)FramePacer_meth_begin_frame, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)FramePacer_meth_exit, METH_FASTCALL, NULL},
+    {},
+};
+
+PyMemberDef FramePacer_members[] = {
+    {"context", T_OBJECT_EX, offsetof(FramePacer, context), READONLY, NULL},
+    {"frames", T_INT, offsetof(FramePacer, frames), READONLY, NULL},
+    {},
+};
+
+PyGetSetDef FramePacer_getset[] = {
+    {"frames_in_flight", (getter)FramePacer_get_frames_in_flight, NULL, NULL, NULL},
+    {},
+};
+
+PyType_Slot FramePacer_slots[] = {
+    {Py_tp_methods, FramePacer_methods},
+    {Py_tp_members, FramePacer_members},
+    {Py_tp_getset, FramePacer_getset},
+    {Py_tp_dealloc, (void *)FramePacer_dealloc},
+    {},
+};
+
+PyType_Spec FramePacer_spec = {"egl.FramePacer", sizeof(FramePacer), 0, Py_TPFLAGS_DEFAULT, FramePacer_slots};
+
+PyObject * meth_configure_pool(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"max_size", "max_idle", NULL};
+
+    int max_size = 0;
+    double max_idle = 0.0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|id", keywords, &max_size, &max_idle)) {
+        return NULL;
+    }
+
+    if (max_size < 0) {
+        PyErr_Format(PyExc_ValueError, "max_size must not be negative");
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    glcontext::configure_egl_pool(max_size, max_idle);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject * meth_pool_stats(PyObject * self) {
+    glcontext::PoolStats stats;
+    Py_BEGIN_ALLOW_THREADS
+    stats = glcontext::egl_pool_stats();
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue(
+        "{sisisLsLsL}",
+        "size", stats.size,
+        "max_size", stats.max_size,
+        "hits", stats.hits,
+        "misses", stats.misses,
+        "evictions", stats.evictions
+    );
+}
+
+PyObject * frozenset_from_strings(const std::vector<std::string> & strings) {
+    PyObject * items = PyList_New(strings.size());
+    for (size_t i = 0; i < strings.size(); ++i) {
+        PyList_SET_ITEM(items, i, PyUnicode_FromString(strings[i].c_str()));
+    }
+    PyObject * res = PyFrozenSet_New(items);
+    Py_DECREF(items);
+    return res;
+}
+
+PyObject * string_or_none(const std::string & value) {
+    if (value.empty()) {
+        Py_RETURN_NONE;
+    }
+    return PyUnicode_FromString(value.c_str());
+}
+
+// The dicts are mutable, callers get their own copies. The strings and frozensets in them are shared.
+PyObject * copy_devices(PyObject * devices) {
+    Py_ssize_t num_devices = PyTuple_GET_SIZE(devices);
+    PyObject * res = PyTuple_New(num_devices);
+    for (Py_ssize_t i = 0; i < num_devices; ++i) {
+        PyObject * info = PyDict_Copy(PyTuple_GET_ITEM(devices, i));
+        if (!info) {
+            Py_DECREF(res);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(res, i, info);
+    }
+    return res;
+}
+
+// The inventory of the default libraries is built once, every later call returns a copy of it.
+PyObject * meth_devices(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"libgl", "libegl", NULL};
+
+    const char * libgl = NULL;
+    const char * libegl = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zz", keywords, &libgl, &libegl)) {
+        return NULL;
+    }
+
+    bool defaults = !libgl && !libegl;
+    if (defaults && default_devices) {
+        return copy_devices(default_devices);
+    }
+
+    std::vector<glcontext::DeviceInfo> devices;
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = glcontext::egl_devices(libgl, libegl, devices);
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+
+    PyObject * res = PyTuple_New(devices.size());
+    for (size_t i = 0; i < devices.size(); ++i) {
+        const glcontext::DeviceInfo & info = devices[i];
+        PyObject * cuda_device = Py_None;
+        if (info.cuda_device >= 0) {
+            cuda_device = PyLong_FromLong(info.cuda_device);
+        } else {
+            Py_INCREF(cuda_device);
+        }
+        PyTuple_SET_ITEM(res, i, Py_BuildValue(
+            "{sisOsNsNsNsNsNsNsNsN}",
+            "index", info.index,
+            "software", info.software ? Py_True : Py_False,
+            "drm_device", string_or_none(info.drm_device),
+            "drm_render_node", string_or_none(info.drm_render_node),
+            "vendor", string_or_none(info.vendor),
+            "renderer", string_or_none(info.renderer),
+            "driver", string_or_none(info.driver),
+            "cuda_device", cuda_device,
+            "extensions", frozenset_from_strings(info.extensions),
+            "platforms", frozenset_from_strings(info.platforms)
+        ));
+    }
+
+    if (defaults) {
+        default_devices = res;
+        return copy_devices(default_devices);
+    }
+    return res;
+}
+
+PyObject * meth_live_contexts(PyObject * self) {
+    int counts[64];
+    int num_devices;
+    Py_BEGIN_ALLOW_THREADS
+    num_devices = glcontext::egl_live_contexts(counts, 64);
+    Py_END_ALLOW_THREADS
+
+    PyObject * res = PyList_New(num_devices < 64 ? num_devices : 64);
+    for (int i = 0; i < PyList_GET_SIZE(res); ++i) {
+        PyList_SET_ITEM(res, i, PyLong_FromLong(counts[i]));
+    }
+    return res;
+}
+
+int capi_make_current(PyObject * context) {
+    return ((GLContext *)context)->context->enter();
+}
+
+int capi_done_current(PyObject * context) {
+    return ((GLContext *)context)->context->exit();
+}
+
+void * capi_get_proc_address(PyObject * context, const char * name) {
+    return ((GLContext *)context)->context->load(name);
+}
+
+void capi_load_many(PyObject * context, const char * const * names, int count, void ** procs) {
+    for (int i = 0; i < count; ++i) {
+        procs[i] = ((GLContext *)context)->context->load(names[i]);
+    }
+}
+
+void capi_release(PyObject * context) {
+    ((GLContext *)context)->context->release();
+}
+
+GLContextCAPI c_api = {
+    GLCONTEXT_CAPI_VERSION,
+    capi_make_current,
+    capi_done_current,
+    capi_get_proc_address,
+    capi_load_many,
+    capi_release,
+};
+
 PyMethodDef module_methods[] = {
     {"create_context", (PyCFunction)meth_create_context, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"create_share_group", (PyCFunction)meth_create_share_group, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"configure_pool", (PyCFunction)meth_configure_pool, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"pool_stats", (PyCFunction)meth_pool_stats, METH_NOARGS, NULL},
+    {"live_contexts", (PyCFunction)meth_live_contexts, METH_NOARGS, NULL},
+    {"devices", (PyCFunction)meth_devices, METH_VARARGS | METH_KEYWORDS, NULL},
     {},
 };
 
@@ -400,7 +768,18 @@ PyModuleDef module_def = {PyModuleDef_HEAD_INIT, "egl", NULL, -1, module_methods
 
 extern "C" PyObject * PyInit_egl() {
     PyObject * module = PyModule_Create(&module_def);
+    PyObject * array = PyImport_ImportModule("array");
+    if (!array) {
+        return NULL;
+    }
+    array_type = PyObject_GetAttrString(array, "array");
+    Py_DECREF(array);
     GLContext_type = (PyTypeObject *)PyType_FromSpec(&GLContext_spec);
     PyModule_AddObject(module, "GLContext", (PyObject *)GLContext_type);
+    Fence_type = (PyTypeObject *)PyType_FromSpec(&Fence_spec);
+    PyModule_AddObject(module, "Fence", (PyObject *)Fence_type);
+    FramePacer_type = (PyTypeObject *)PyType_FromSpec(&FramePacer_spec);
+    PyModule_AddObject(module, "FramePacer", (PyObject *)FramePacer_type);
+    PyModule_AddObject(module, "c_api", PyCapsule_New(&c_api, "glcontext.egl.c_api", NULL));
     return module;
 }
@@ -25,7 +25,7 @@ PyObject * GLContext_meth_enter(GLContext * self) {
     Py_RETURN_NONE;
 }
 
-PyObject * GLContext_meth_exit(GLContext * self) {
+PyObject * GLContext_meth_exit(GLContext * self, PyObject * const * args, Py_ssize_t nargs) {
     Py_RETURN_NONE;
 }
 
@@ -41,7 +41,7 @@ PyMethodDef GLContext_methods[] = {
     {"load_opengl_function", (PyCFunction)GLContext_meth_load, METH_O, NULL},
     {"release", (PyCFunction)GLContext_meth_release, METH_NOARGS, NULL},
     {"__enter__", (PyCFunction)GLContext_meth_enter, METH_NOARGS, NULL},
-    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_VARARGS, NULL},
+    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_FASTCALL, NULL},
     {},
 };
 
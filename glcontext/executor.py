@@ -0,0 +1,134 @@
+import os
+import queue
+import threading
+from concurrent.futures import BrokenExecutor, Executor, Future
+
+
+class ContextExecutor(Executor):
+    """Run work items on worker threads that each own an OpenGL context.
+
+    The worker contexts are standalone egl contexts on the same device and
+    share their objects with each other and with ``executor.context``.
+    Every work item runs with the context of its worker already current.
+    A worker that cannot make its context current breaks the executor, pending
+    work items fail with ``BrokenExecutor`` and no new ones are accepted.
+
+    Example::
+
+        from glcontext.executor import ContextExecutor
+
+        with ContextExecutor(workers=4, glversion=330) as executor:
+            futures = [executor.submit(upload, chunk) for chunk in chunks]
+    """
+
+    def __init__(self, workers=None, **kwargs):
+        from glcontext import egl
+
+        if workers is None:
+            workers = os.cpu_count() or 1
+
+        if workers < 1:
+            raise ValueError('workers must be at least 1')
+
+        if kwargs.pop('mode', 'standalone') != 'standalone':
+            raise ValueError('the executor only supports standalone contexts')
+
+        self.context, *self._contexts = egl.create_share_group(workers + 1, **kwargs)
+        self.context.__exit__(None, None, None)
+
+        self._queue = queue.SimpleQueue()
+        self._lock = threading.Lock()
+        self._shutdown = False
+        self._broken = None
+        self._running = len(self._contexts)
+        self._threads = []
+        for ctx in self._contexts:
+            thread = threading.Thread(target=self._worker, args=(ctx,), daemon=True, name='glcontext-worker')
+            thread.start()
+            self._threads.append(thread)
+
+    @property
+    def contexts(self):
+        """The worker contexts"""
+        return tuple(self._contexts)
+
+    def submit(self, fn, *args, **kwargs):
+        with self._lock:
+            if self._broken:
+                raise BrokenExecutor(self._broken)
+            if self._shutdown:
+                raise RuntimeError('cannot schedule new futures after shutdown')
+            future = Future()
+            self._queue.put((future, fn, args, kwargs))
+            return future
+
+    def shutdown(self, wait=True, *, cancel_futures=False):
+        with self._lock:
+            if self._shutdown:
+                return
+            self._shutdown = True
+            if cancel_futures:
+                while True:
+                    try:
+                        item = self._queue.get_nowait()
+                    except queue.Empty:
+                        break
+                    item[0].cancel()
+            for _ in self._threads:
+                self._queue.put(None)
+
+        if wait:
+            for thread in self._threads:
+                thread.join()
+
+    def _worker(self, ctx):
+        try:
+            self._run(ctx)
+        finally:
+            ctx.release()
+            # the last worker to exit releases the executor context, with or without shutdown(wait=True)
+            with self._lock:
+                self._running -= 1
+                last = not self._running
+            if last:
+                self.context.release()
+
+    def _run(self, ctx):
+        try:
+            ctx.__enter__()
+        except Exception as ex:
+            self._set_broken('a worker could not make its context current: {}'.format(ex))
+            return
+
+        try:
+            while True:
+                item = self._queue.get()
+                if item is None:
+                    break
+                future, fn, args, kwargs = item
+                if not future.set_running_or_notify_cancel():
+                    continue
+                try:
+                    result = fn(*args, **kwargs)
+                except BaseException as ex:
+                    future.set_exception(ex)
+                else:
+                    future.set_result(result)
+        finally:
+            ctx.__exit__(None, None, None)
+
+    def _set_broken(self, message):
+        with self._lock:
+            if self._broken:
+                return
+            self._broken = message
+            while True:
+                try:
+                    item = self._queue.get_nowait()
+                except queue.Empty:
+                    break
+                if item is not None and item[0].set_running_or_notify_cancel():
+                    item[0].set_exception(BrokenExecutor(message))
+            # the other workers stop once they finished their current work item
+            for _ in self._threads:
+                self._queue.put(None)
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Python.h>
+
+// C level API exported by the x11 and egl backends as a capsule.
+// Native extensions can switch and query contexts without going through Python:
+//
+//     const GLContextCAPI * api = (const GLContextCAPI *)PyCapsule_Import("glcontext.egl.c_api", 0);
+//     if (!api || api->version < GLCONTEXT_CAPI_VERSION) { ... }
+//
+// The functions do not call into Python, they can be called with or without the GIL held.
+// The context argument must be a GLContext of the same backend and the caller must keep a reference to it.
+// make_current and done_current use the same per-thread binding stack as __enter__ and __exit__.
+// make_current returns 0 and keeps the current binding on failure, done_current must not be called then.
+
+#define GLCONTEXT_CAPI_VERSION 1
+
+struct GLContextCAPI {
+    int version;
+    int (* make_current)(PyObject * context);
+    int (* done_current)(PyObject * context);
+    void * (* get_proc_address)(PyObject * context, const char * name);
+    void (* load_many)(PyObject * context, const char * const * names, int count, void ** procs);
+    void (* release)(PyObject * context);
+};
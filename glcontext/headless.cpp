@@ -1,86 +1,268 @@
 #include <Python.h>
+#include <structmember.h>
+
+#include <vector>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
-int num_devices;
-EGLDeviceEXT devices[64];
+// Every device gets its own initialized display and config, contexts keep a reference to their device.
+// Devices are opened once per process and stay open, so contexts on different devices live side by side.
+struct HeadlessDevice {
+    PyObject_HEAD
 
-EGLContext context;
-EGLDisplay display;
-EGLConfig config;
+    int index;
+    EGLDeviceEXT device;
+    EGLDisplay display;
+    EGLConfig config;
+};
+
+struct HeadlessContext {
+    PyObject_HEAD
+
+    HeadlessDevice * device;
+    EGLContext context;
+};
+
+struct Binding {
+    EGLDisplay display;
+    EGLSurface draw;
+    EGLSurface read;
+    EGLContext context;
+};
+
+PyTypeObject * HeadlessDevice_type;
+PyTypeObject * HeadlessContext_type;
+
+bool devices_queried;
+std::vector<EGLDeviceEXT> devices;
+std::vector<HeadlessDevice *> opened_devices;
+
+// The context made current by init(), replaced by the next call.
+HeadlessContext * default_context;
+
+thread_local std::vector<Binding> binding_stack;
+
+bool query_devices() {
+    if (devices_queried) {
+        return true;
+    }
 
-PyObject * meth_devices(PyObject * self) {
     PFNEGLQUERYDEVICESEXTPROC eglQueryDevicesEXT = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
-    PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT = (PFNEGLQUERYDEVICESTRINGEXTPROC)eglGetProcAddress("eglQueryDeviceStringEXT");
+    if (!eglQueryDevicesEXT) {
+        PyErr_Format(PyExc_Exception, "eglQueryDevicesEXT not found");
+        return false;
+    }
 
+    EGLint num_devices = 0;
     if (!eglQueryDevicesEXT(0, NULL, &num_devices)) {
-        return NULL;
+        PyErr_Format(PyExc_Exception, "eglQueryDevicesEXT failed (0x%x)", eglGetError());
+        return false;
     }
 
-    if (!eglQueryDevicesEXT(num_devices, devices, &num_devices)) {
-        return NULL;
+    devices.resize(num_devices);
+    if (!eglQueryDevicesEXT(num_devices, devices.data(), &num_devices)) {
+        PyErr_Format(PyExc_Exception, "eglQueryDevicesEXT failed (0x%x)", eglGetError());
+        devices.clear();
+        return false;
     }
 
-    PyObject * res = PyList_New(num_devices);
-    for (int i = 0; i < num_devices; ++i) {
-        const char * egl_extensions = eglQueryDeviceStringEXT(devices[i], EGL_EXTENSIONS);
-        PyObject * temp = PyUnicode_FromString(egl_extensions ? egl_extensions : "");
-        PyObject * extensions = PyObject_CallMethod(temp, "split", NULL);
-        Py_DECREF(temp);
-        PyList_SetItem(res, i, Py_BuildValue("{sisN}", "device", i, "extensions", extensions));
-    }
-    return res;
+    devices.resize(num_devices);
+    opened_devices.resize(num_devices);
+    devices_queried = true;
+    return true;
 }
 
-PyObject * meth_init(PyObject * self, PyObject * args, PyObject * kwargs) {
-    const char * keywords[] = {"device", NULL};
+EGLint init_display(HeadlessDevice * self) {
+    self->display = eglGetPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, self->device, 0);
+    if (self->display == EGL_NO_DISPLAY) {
+        return eglGetError();
+    }
 
-    int device = 0;
+    if (!eglInitialize(self->display, NULL, NULL)) {
+        return eglGetError();
+    }
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i", (char **)keywords, &device)) {
-        return NULL;
+    int config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE,
+    };
+
+    int num_configs = 0;
+    if (!eglChooseConfig(self->display, config_attribs, &self->config, 1, &num_configs)) {
+        return eglGetError();
     }
 
-    if (device > num_devices) {
+    return EGL_SUCCESS;
+}
+
+HeadlessDevice * open_device(int index) {
+    if (!query_devices()) {
         return NULL;
     }
 
-    display = eglGetPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[device], 0);
-    if (display == EGL_NO_DISPLAY) {
+    int num_devices = (int)devices.size();
+    if (index < 0 || index >= num_devices) {
+        PyErr_Format(PyExc_ValueError, "requested device index %d, but found %d devices", index, num_devices);
         return NULL;
     }
 
-    if (!eglInitialize(display, NULL, NULL)) {
-        return NULL;
+    if (opened_devices[index]) {
+        Py_INCREF(opened_devices[index]);
+        return opened_devices[index];
     }
 
-    int config_attribs[] = {
-        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
-        EGL_NONE,
-    };
+    HeadlessDevice * res = PyObject_New(HeadlessDevice, HeadlessDevice_type);
+    res->index = index;
+    res->device = devices[index];
+    res->display = EGL_NO_DISPLAY;
+    res->config = NULL;
 
-    int num_configs = 0;
-    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs)) {
+    EGLint error;
+    Py_BEGIN_ALLOW_THREADS
+    error = init_display(res);
+    Py_END_ALLOW_THREADS
+
+    if (error != EGL_SUCCESS) {
+        PyErr_Format(PyExc_Exception, "cannot initialize device %d (0x%x)", index, error);
+        Py_DECREF(res);
         return NULL;
     }
 
+    Py_INCREF(res);
+    opened_devices[index] = res;
+    return res;
+}
+
+EGLContext create_context(HeadlessDevice * device, int glversion, EGLContext share) {
     if (!eglBindAPI(EGL_OPENGL_API)) {
-        return NULL;
+        return EGL_NO_CONTEXT;
     }
 
+    // without a version the driver picks the highest core profile it supports
     int context_attribs[] = {
         EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
+        EGL_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
         EGL_NONE,
     };
 
-    context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (!glversion) {
+        context_attribs[2] = EGL_NONE;
+    }
+
+    return eglCreateContext(device->display, device->config, share, context_attribs);
+}
+
+HeadlessContext * new_context(HeadlessDevice * device, int glversion, HeadlessContext * share) {
+    if (share && share->device != device) {
+        PyErr_Format(PyExc_ValueError, "share must be a context of the same device");
+        return NULL;
+    }
+
+    EGLContext context;
+    EGLint error = EGL_SUCCESS;
+    Py_BEGIN_ALLOW_THREADS
+    context = create_context(device, glversion, share ? share->context : EGL_NO_CONTEXT);
     if (!context) {
+        error = eglGetError();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!context) {
+        PyErr_Format(PyExc_Exception, "eglCreateContext failed (0x%x)", error);
+        return NULL;
+    }
+
+    HeadlessContext * res = PyObject_New(HeadlessContext, HeadlessContext_type);
+    Py_INCREF(device);
+    res->device = device;
+    res->context = context;
+    return res;
+}
+
+// The extensions are split once into a tuple per device, every call builds new dicts and lists from them.
+PyObject * meth_devices(PyObject * self) {
+    static PyObject * device_extensions;
+    if (!device_extensions) {
+        if (!query_devices()) {
+            return NULL;
+        }
+
+        PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT = (PFNEGLQUERYDEVICESTRINGEXTPROC)eglGetProcAddress("eglQueryDeviceStringEXT");
+
+        int num_devices = (int)devices.size();
+        PyObject * res = PyTuple_New(num_devices);
+        for (int i = 0; i < num_devices; ++i) {
+            const char * egl_extensions = eglQueryDeviceStringEXT(devices[i], EGL_EXTENSIONS);
+            PyObject * temp = PyUnicode_FromString(egl_extensions ? egl_extensions : "");
+            PyObject * extensions = PyObject_CallMethod(temp, "split", NULL);
+            Py_DECREF(temp);
+            PyTuple_SET_ITEM(res, i, PySequence_Tuple(extensions));
+            Py_DECREF(extensions);
+        }
+        device_extensions = res;
+    }
+
+    int num_devices = (int)PyTuple_GET_SIZE(device_extensions);
+    PyObject * res = PyList_New(num_devices);
+    for (int i = 0; i < num_devices; ++i) {
+        PyObject * extensions = PySequence_List(PyTuple_GET_ITEM(device_extensions, i));
+        PyList_SET_ITEM(res, i, Py_BuildValue("{sisN}", "device", i, "extensions", extensions));
+    }
+    return res;
+}
+
+PyObject * meth_device(PyObject * self, PyObject * args, PyObject * kwargs) {
+    const char * keywords[] = {"index", NULL};
+
+    int index = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i", (char **)keywords, &index)) {
         return NULL;
     }
 
-    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+    return (PyObject *)open_device(index);
+}
+
+PyObject * meth_init(PyObject * self, PyObject * args, PyObject * kwargs) {
+    const char * keywords[] = {"device", NULL};
+
+    int index = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i", (char **)keywords, &index)) {
+        return NULL;
+    }
+
+    HeadlessDevice * device = open_device(index);
+    if (!device) {
+        return NULL;
+    }
+
+    HeadlessContext * context = new_context(device, 0, NULL);
+    Py_DECREF(device);
+    if (!context) {
+        return NULL;
+    }
+
+    EGLBoolean success;
+    EGLint error = EGL_SUCCESS;
+    Py_BEGIN_ALLOW_THREADS
+    success = eglMakeCurrent(device->display, EGL_NO_SURFACE, EGL_NO_SURFACE, context->context);
+    if (!success) {
+        error = eglGetError();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        Py_DECREF(context);
+        PyErr_Format(PyExc_Exception, "eglMakeCurrent failed (0x%x)", error);
+        return NULL;
+    }
+
+    // the context of a previous call is destroyed instead of leaked
+    Py_XSETREF(default_context, context);
     Py_RETURN_NONE;
 }
 
@@ -92,8 +274,135 @@ PyObject * meth_load_opengl_function(PyObject * self, PyObject * arg) {
     return PyLong_FromVoidPtr((void *)eglGetProcAddress(name));
 }
 
+PyObject * HeadlessDevice_meth_create_context(HeadlessDevice * self, PyObject * args, PyObject * kwargs) {
+    const char * keywords[] = {"glversion", "share", NULL};
+
+    int glversion = 330;
+    HeadlessContext * share = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iO!", (char **)keywords, &glversion, HeadlessContext_type, &share)) {
+        return NULL;
+    }
+
+    return (PyObject *)new_context(self, glversion, share);
+}
+
+void HeadlessDevice_dealloc(HeadlessDevice * self) {
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyObject * HeadlessContext_meth_load(HeadlessContext * self, PyObject * arg) {
+    const char * name = PyUnicode_AsUTF8(arg);
+    if (!name) {
+        return NULL;
+    }
+    return PyLong_FromVoidPtr((void *)eglGetProcAddress(name));
+}
+
+// A failed __enter__ pushes no binding, __exit__ is not called when it raises.
+PyObject * HeadlessContext_meth_enter(HeadlessContext * self) {
+    if (!self->context) {
+        PyErr_Format(PyExc_Exception, "the context was released");
+        return NULL;
+    }
+
+    Binding previous = {eglGetCurrentDisplay(), eglGetCurrentSurface(EGL_DRAW), eglGetCurrentSurface(EGL_READ), eglGetCurrentContext()};
+    EGLBoolean success;
+    EGLint error = EGL_SUCCESS;
+    Py_BEGIN_ALLOW_THREADS
+    success = eglMakeCurrent(self->device->display, EGL_NO_SURFACE, EGL_NO_SURFACE, self->context);
+    if (!success) {
+        error = eglGetError();
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!success) {
+        PyErr_Format(PyExc_Exception, "eglMakeCurrent failed (0x%x)", error);
+        return NULL;
+    }
+    binding_stack.push_back(previous);
+    Py_RETURN_NONE;
+}
+
+PyObject * HeadlessContext_meth_exit(HeadlessContext * self, PyObject * const * args, Py_ssize_t nargs) {
+    Binding previous = {self->device->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT};
+    if (binding_stack.size()) {
+        if (binding_stack.back().context) {
+            previous = binding_stack.back();
+        }
+        binding_stack.pop_back();
+    }
+    Py_BEGIN_ALLOW_THREADS
+    eglMakeCurrent(previous.display, previous.draw, previous.read, previous.context);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+PyObject * HeadlessContext_meth_release(HeadlessContext * self) {
+    if (!self->context) {
+        Py_RETURN_NONE;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (eglGetCurrentContext() == self->context) {
+        eglMakeCurrent(self->device->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    eglDestroyContext(self->device->display, self->context);
+    Py_END_ALLOW_THREADS
+    self->context = EGL_NO_CONTEXT;
+    Py_RETURN_NONE;
+}
+
+void HeadlessContext_dealloc(HeadlessContext * self) {
+    Py_XDECREF(HeadlessContext_meth_release(self));
+    Py_DECREF(self->device);
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyMethodDef HeadlessDevice_methods[] = {
+    {"create_context", (PyCFunction)HeadlessDevice_meth_create_context, METH_VARARGS | METH_KEYWORDS},
+    {},
+};
+
+PyMemberDef HeadlessDevice_members[] = {
+    {"index", T_INT, offsetof(HeadlessDevice, index), READONLY, NULL},
+    {},
+};
+
+PyType_Slot HeadlessDevice_slots[] = {
+    {Py_tp_methods, HeadlessDevice_methods},
+    {Py_tp_members, HeadlessDevice_members},
+    {Py_tp_dealloc, (void *)HeadlessDevice_dealloc},
+    {},
+};
+
+PyType_Spec HeadlessDevice_spec = {"headless.HeadlessDevice", sizeof(HeadlessDevice), 0, Py_TPFLAGS_DEFAULT, HeadlessDevice_slots};
+
+PyMethodDef HeadlessContext_methods[] = {
+    {"load", (PyCFunction)HeadlessContext_meth_load, METH_O},
+    {"load_opengl_function", (PyCFunction)HeadlessContext_meth_load, METH_O},
+    {"release", (PyCFunction)HeadlessContext_meth_release, METH_NOARGS},
+    {"__enter__", (PyCFunction)HeadlessContext_meth_enter, METH_NOARGS},
+    {"__exit__", (PyCFunction)HeadlessContext_meth_exit, METH_FASTCALL},
+    {},
+};
+
+PyMemberDef HeadlessContext_members[] = {
+    {"device", T_OBJECT_EX, offsetof(HeadlessContext, device), READONLY, NULL},
+    {},
+};
+
+PyType_Slot HeadlessContext_slots[] = {
+    {Py_tp_methods, HeadlessContext_methods},
+    {Py_tp_members, HeadlessContext_members},
+    {Py_tp_dealloc, (void *)HeadlessContext_dealloc},
+    {},
+};
+
+PyType_Spec HeadlessContext_spec = {"headless.HeadlessContext", sizeof(HeadlessContext), 0, Py_TPFLAGS_DEFAULT, HeadlessContext_slots};
+
 PyMethodDef module_methods[] = {
     {"devices", (PyCFunction)meth_devices, METH_NOARGS},
+    {"device", (PyCFunction)meth_device, METH_VARARGS | METH_KEYWORDS},
     {"init", (PyCFunction)meth_init, METH_VARARGS | METH_KEYWORDS},
     {"load_opengl_function", (PyCFunction)meth_load_opengl_function, METH_O},
     {},
@@ -103,5 +412,9 @@ PyModuleDef module_def = {PyModuleDef_HEAD_INIT, "headless", NULL, -1, module_me
 
 extern "C" PyObject * PyInit_headless() {
     PyObject * module = PyModule_Create(&module_def);
+    HeadlessDevice_type = (PyTypeObject *)PyType_FromSpec(&HeadlessDevice_spec);
+    PyModule_AddObject(module, "HeadlessDevice", (PyObject *)HeadlessDevice_type);
+    HeadlessContext_type = (PyTypeObject *)PyType_FromSpec(&HeadlessContext_spec);
+    PyModule_AddObject(module, "HeadlessContext", (PyObject *)HeadlessContext_type);
     return module;
 }
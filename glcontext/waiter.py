@@ -0,0 +1,65 @@
+import asyncio
+import queue
+import threading
+
+_lock = threading.Lock()
+_waiter = None
+
+
+class FenceWaiter:
+    """Wait for fences on a single background thread and resolve asyncio futures.
+
+    Fences are waited on in the order they were submitted. A GPU executes the
+    commands of a device in order, so later fences rarely signal first.
+    The thread blocks in the driver with the GIL released.
+    """
+
+    def __init__(self):
+        self._queue = queue.SimpleQueue()
+        self._thread = threading.Thread(target=self._run, daemon=True, name='glcontext-fence-waiter')
+        self._thread.start()
+
+    def wait(self, fence):
+        """Return an asyncio future of the running loop that resolves once the fence is signaled"""
+        loop = asyncio.get_running_loop()
+        future = loop.create_future()
+        self._queue.put((fence, loop, future))
+        return future
+
+    def _run(self):
+        while True:
+            fence, loop, future = self._queue.get()
+            try:
+                fence.client_wait()
+            except Exception as ex:
+                _call_soon(loop, _set_exception, future, ex)
+            else:
+                _call_soon(loop, _set_result, future, None)
+            del fence, loop, future
+
+
+def wait_fence(fence):
+    """Await a fence without blocking the event loop, used by ``GLContext.gpu_done()``"""
+    global _waiter
+    with _lock:
+        if _waiter is None:
+            _waiter = FenceWaiter()
+    return _waiter.wait(fence)
+
+
+def _call_soon(loop, callback, *args):
+    try:
+        loop.call_soon_threadsafe(callback, *args)
+    except RuntimeError:
+        # the loop was closed while the fence was pending
+        pass
+
+
+def _set_result(future, result):
+    if not future.done():
+        future.set_result(result)
+
+
+def _set_exception(future, ex):
+    if not future.done():
+        future.set_exception(ex)
@@ -3,6 +3,8 @@
 
 #include <Windows.h>
 
+#include <vector>
+
 #define WGL_CONTEXT_PROFILE_MASK 0x9126
 #define WGL_CONTEXT_CORE_PROFILE_BIT 0x0001
 #define WGL_CONTEXT_MAJOR_VERSION 0x2091
@@ -28,8 +30,6 @@ struct GLContext {
     HGLRC hrc;
 
     int standalone;
-    void * old_context;
-    void * old_display;
 
     m_wglGetCurrentContextProc m_wglGetCurrentContext;
     m_wglGetCurrentDCProc m_wglGetCurrentDC;
@@ -41,6 +41,14 @@ struct GLContext {
     m_wglSwapIntervalEXTProc m_wglSwapIntervalEXT;
 };
 
+// The bindings to restore when leaving nested with blocks on the calling thread.
+struct Binding {
+    HDC hdc;
+    HGLRC hrc;
+};
+
+thread_local std::vector<Binding> binding_stack;
+
 PyTypeObject * GLContext_type;
 
 GLContext * meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
@@ -271,14 +279,20 @@ PyObject * GLContext_meth_load(GLContext * self, PyObject * arg) {
 }
 
 PyObject * GLContext_meth_enter(GLContext * self) {
-    self->old_context = (void *)self->m_wglGetCurrentContext();
-    self->old_display = (void *)self->m_wglGetCurrentDC();
+    Binding previous = {self->m_wglGetCurrentDC(), self->m_wglGetCurrentContext()};
+    binding_stack.push_back(previous);
     self->m_wglMakeCurrent(self->hdc, self->hrc);
     Py_RETURN_NONE;
 }
 
-PyObject * GLContext_meth_exit(GLContext * self) {
-    self->m_wglMakeCurrent((HDC)self->old_display, (HGLRC)self->old_context);
+PyObject * GLContext_meth_exit(GLContext * self, PyObject * const * args, Py_ssize_t nargs) {
+    if (binding_stack.empty()) {
+        self->m_wglMakeCurrent(NULL, NULL);
+        Py_RETURN_NONE;
+    }
+    Binding previous = binding_stack.back();
+    binding_stack.pop_back();
+    self->m_wglMakeCurrent(previous.hdc, previous.hrc);
     Py_RETURN_NONE;
 }
 
@@ -301,7 +315,7 @@ PyMethodDef GLContext_methods[] = {
     {"load_opengl_function", (PyCFunction)GLContext_meth_load, METH_O, NULL},
     {"release", (PyCFunction)GLContext_meth_release, METH_NOARGS, NULL},
     {"__enter__", (PyCFunction)GLContext_meth_enter, METH_NOARGS, NULL},
-    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_VARARGS, NULL},
+    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_FASTCALL, NULL},
     {},
 };
 
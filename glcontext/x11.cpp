@@ -1,511 +1,529 @@
 #include <Python.h>
 #include <structmember.h>
 
-#include <dlfcn.h>
-#include <X11/Xlib.h>
-#include <X11/Xutil.h>
-
-#define GLX_CONTEXT_MAJOR_VERSION 0x2091
-#define GLX_CONTEXT_MINOR_VERSION 0x2092
-#define GLX_CONTEXT_PROFILE_MASK 0x9126
-#define GLX_CONTEXT_CORE_PROFILE_BIT 0x0001
-
-#define GLX_RGBA 4
-#define GLX_DOUBLEBUFFER 5
-#define GLX_RED_SIZE 8
-#define GLX_GREEN_SIZE 9
-#define GLX_BLUE_SIZE 10
-#define GLX_DEPTH_SIZE 12
-
-typedef struct __GLXcontextRec * GLXContext;
-typedef struct __GLXFBConfigRec * GLXFBConfig;
-typedef XID GLXDrawable;
-
-typedef GLXFBConfig * (* m_glXChooseFBConfigProc)(Display *, int, const int *, int *);
-typedef XVisualInfo * (* m_glXChooseVisualProc)(Display *, int, int *);
-typedef Display * (* m_glXGetCurrentDisplayProc)();
-typedef GLXContext (* m_glXGetCurrentContextProc)();
-typedef GLXDrawable (* m_glXGetCurrentDrawableProc)();
-typedef Bool (* m_glXMakeCurrentProc)(Display *, GLXDrawable, GLXContext);
-typedef void (* m_glXDestroyContextProc)(Display *, GLXContext);
-typedef GLXContext (* m_glXCreateContextProc)(Display *, XVisualInfo *, GLXContext, Bool);
-typedef void (*(* m_glXGetProcAddressProc)(const unsigned char *))();
-typedef GLXContext (* m_glXCreateContextAttribsARBProc)(Display *, GLXFBConfig, GLXContext, int, const int *);
-
-typedef Display * (* m_XOpenDisplayProc)(const char *);
-typedef int (* m_XDefaultScreenProc)(Display *);
-typedef Window (* m_XRootWindowProc)(Display *, int);
-typedef Colormap (* m_XCreateColormapProc)(Display *, Window, Visual *, int);
-typedef Window (* m_XCreateWindowProc)(Display *, Window, int, int, unsigned int, unsigned int, unsigned int, int, unsigned int, Visual *, unsigned long, XSetWindowAttributes *);
-typedef int (* m_XDestroyWindowProc)(Display *, Window);
-typedef int (* m_XCloseDisplayProc)(Display *);
-typedef int (* m_XFreeProc)(void *);
-typedef XErrorHandler (* m_XSetErrorHandlerProc)(XErrorHandler);
-
-int SilentXErrorHandler(Display * d, XErrorEvent * e) {
-    return 0;
-}
+#include <cstring>
+#include <vector>
+
+#include "glcontext.hpp"
+#include "core/context.hpp"
 
 struct GLContext {
     PyObject_HEAD
 
-    void * libgl;
-    void * libx11;
-    Display * dpy;
-    GLXFBConfig * fbc;
-    XVisualInfo * vi;
-    Window wnd;
-    GLXContext ctx;
-
+    glcontext::Context * context;
     int standalone;
-    int own_window;
-    void * old_context;
-    void * old_display;
-    void * old_window;
-
-    m_glXChooseFBConfigProc m_glXChooseFBConfig;
-    m_glXChooseVisualProc m_glXChooseVisual;
-    m_glXGetCurrentDisplayProc m_glXGetCurrentDisplay;
-    m_glXGetCurrentContextProc m_glXGetCurrentContext;
-    m_glXGetCurrentDrawableProc m_glXGetCurrentDrawable;
-    m_glXMakeCurrentProc m_glXMakeCurrent;
-    m_glXDestroyContextProc m_glXDestroyContext;
-    m_glXCreateContextProc m_glXCreateContext;
-    m_glXGetProcAddressProc m_glXGetProcAddress;
-    m_glXCreateContextAttribsARBProc m_glXCreateContextAttribsARB;
-
-    m_XOpenDisplayProc m_XOpenDisplay;
-    m_XDefaultScreenProc m_XDefaultScreen;
-    m_XRootWindowProc m_XRootWindow;
-    m_XCreateColormapProc m_XCreateColormap;
-    m_XCreateWindowProc m_XCreateWindow;
-    m_XDestroyWindowProc m_XDestroyWindow;
-    m_XCloseDisplayProc m_XCloseDisplay;
-    m_XFreeProc m_XFree;
-    m_XSetErrorHandlerProc m_XSetErrorHandler;
+    int no_error;
+};
+
+struct Fence {
+    PyObject_HEAD
+
+    glcontext::Fence * fence;
+    PyObject * context;
+};
+
+struct FramePacer {
+    PyObject_HEAD
+
+    glcontext::FramePacer * pacer;
+    PyObject * context;
+    int frames;
 };
 
 PyTypeObject * GLContext_type;
+PyTypeObject * Fence_type;
+PyTypeObject * FramePacer_type;
+PyObject * array_type;
 
-GLContext * meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
-    static char * keywords[] = {"mode", "libgl", "libx11", "glversion", NULL};
+struct ConfigAttribName {
+    const char * name;
+    int attrib;
+};
 
-    const char * mode = "detect";
-    const char * libgl = "libGL.so";
-    const char * libx11 = "libX11.so";
-    int glversion = 330;
+#define CONFIG_ATTRIB_END 0
+
+ConfigAttribName config_attrib_names[] = {
+    {"red_size", 8},
+    {"green_size", 9},
+    {"blue_size", 10},
+    {"alpha_size", 11},
+    {"depth_size", 12},
+    {"stencil_size", 13},
+    {"samples", 100001},
+    {"sample_buffers", 100000},
+    {},
+};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sssi", keywords, &mode, &libgl, &libx11, &glversion)) {
-        return NULL;
+// config is None for the default config, "none" for a context without a config or a dict of framebuffer sizes.
+// The sizes are minimums, the matching config with the smallest default framebuffer is selected.
+bool parse_config(PyObject * config, std::vector<int> & attribs, glcontext::ContextOptions * options) {
+    if (!config || config == Py_None) {
+        return true;
     }
 
-    GLContext * res = PyObject_New(GLContext, GLContext_type);
-
-    res->libgl = dlopen(libgl, RTLD_LAZY);
-    if (!res->libgl) {
-        PyErr_Format(PyExc_Exception, "%s not found in /lib, /usr/lib or LD_LIBRARY_PATH", libgl);
-        return NULL;
+    if (PyUnicode_Check(config) && !PyUnicode_CompareWithASCIIString(config, "none")) {
+        options->no_config = true;
+        return true;
     }
 
-    res->m_glXChooseFBConfig = (m_glXChooseFBConfigProc)dlsym(res->libgl, "glXChooseFBConfig");
-    if (!res->m_glXChooseFBConfig) {
-        PyErr_Format(PyExc_Exception, "glXChooseFBConfig not found");
-        return NULL;
+    if (!PyDict_Check(config)) {
+        PyErr_Format(PyExc_TypeError, "config must be None, 'none' or a dict");
+        return false;
     }
 
-    res->m_glXChooseVisual = (m_glXChooseVisualProc)dlsym(res->libgl, "glXChooseVisual");
-    if (!res->m_glXChooseVisual) {
-        PyErr_Format(PyExc_Exception, "glXChooseVisual not found");
-        return NULL;
+    PyObject * key;
+    PyObject * value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(config, &pos, &key, &value)) {
+        const char * name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : NULL;
+        int attrib = 0;
+        for (int i = 0; name && config_attrib_names[i].name; ++i) {
+            if (!strcmp(config_attrib_names[i].name, name)) {
+                attrib = config_attrib_names[i].attrib;
+            }
+        }
+        if (!attrib) {
+            PyErr_Format(PyExc_KeyError, "unknown config attribute %R", key);
+            return false;
+        }
+        int size = PyLong_AsLong(value);
+        if (PyErr_Occurred()) {
+            return false;
+        }
+        attribs.push_back(attrib);
+        attribs.push_back(size);
     }
 
-    res->m_glXGetCurrentDisplay = (m_glXGetCurrentDisplayProc)dlsym(res->libgl, "glXGetCurrentDisplay");
-    if (!res->m_glXGetCurrentDisplay) {
-        PyErr_Format(PyExc_Exception, "glXGetCurrentDisplay not found");
-        return NULL;
+    attribs.push_back(CONFIG_ATTRIB_END);
+    options->config_attribs = attribs.data();
+    return true;
+}
+
+bool parse_release_behavior(const char * release_behavior, glcontext::ContextOptions * options) {
+    if (!strcmp(release_behavior, "flush")) {
+        options->release_behavior = GLCONTEXT_RELEASE_FLUSH;
+        return true;
+    }
+    if (!strcmp(release_behavior, "none")) {
+        options->release_behavior = GLCONTEXT_RELEASE_NONE;
+        return true;
     }
+    PyErr_Format(PyExc_ValueError, "release_behavior must be 'flush' or 'none'");
+    return false;
+}
+
+GLContext * meth_create_context(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"mode", "libgl", "libx11", "glversion", "config", "no_error", "release_behavior", NULL};
+
+    const char * mode = "detect";
+    const char * libgl = NULL;
+    const char * libx11 = NULL;
+    int glversion = 330;
+    PyObject * config = NULL;
+    int no_error = false;
+    const char * release_behavior = "flush";
 
-    res->m_glXGetCurrentContext = (m_glXGetCurrentContextProc)dlsym(res->libgl, "glXGetCurrentContext");
-    if (!res->m_glXGetCurrentContext) {
-        PyErr_Format(PyExc_Exception, "glXGetCurrentContext not found");
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sssiOps", keywords, &mode, &libgl, &libx11, &glversion, &config, &no_error, &release_behavior)) {
         return NULL;
     }
 
-    res->m_glXGetCurrentDrawable = (m_glXGetCurrentDrawableProc)dlsym(res->libgl, "glXGetCurrentDrawable");
-    if (!res->m_glXGetCurrentDrawable) {
-        PyErr_Format(PyExc_Exception, "glXGetCurrentDrawable not found");
+    std::vector<int> config_attribs;
+    glcontext::ContextOptions options = {};
+    options.no_error = no_error;
+    if (!parse_config(config, config_attribs, &options) || !parse_release_behavior(release_behavior, &options)) {
         return NULL;
     }
 
-    res->m_glXMakeCurrent = (m_glXMakeCurrentProc)dlsym(res->libgl, "glXMakeCurrent");
-    if (!res->m_glXMakeCurrent) {
-        PyErr_Format(PyExc_Exception, "glXMakeCurrent not found");
+    glcontext::Context * context;
+    Py_BEGIN_ALLOW_THREADS
+    context = glcontext::create_x11_context(mode, libgl, libx11, glversion, &options);
+    Py_END_ALLOW_THREADS
+
+    if (!context) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
         return NULL;
     }
 
-    res->m_glXDestroyContext = (m_glXDestroyContextProc)dlsym(res->libgl, "glXDestroyContext");
-    if (!res->m_glXDestroyContext) {
-        PyErr_Format(PyExc_Exception, "glXDestroyContext not found");
+    GLContext * res = PyObject_New(GLContext, GLContext_type);
+    res->context = context;
+    res->standalone = context->standalone();
+    res->no_error = context->no_error();
+    return res;
+}
+
+PyObject * GLContext_meth_load(GLContext * self, PyObject * arg) {
+    const char * method = PyUnicode_AsUTF8(arg);
+    if (!method) {
         return NULL;
     }
+    return PyLong_FromVoidPtr(self->context->load(method));
+}
 
-    res->m_glXCreateContext = (m_glXCreateContextProc)dlsym(res->libgl, "glXCreateContext");
-    if (!res->m_glXCreateContext) {
-        PyErr_Format(PyExc_Exception, "glXCreateContext not found");
+PyObject * GLContext_meth_load_many(GLContext * self, PyObject * arg) {
+    PyObject * names = PySequence_Fast(arg, "load_many() expects a sequence of names");
+    if (!names) {
         return NULL;
     }
 
-    res->m_glXGetProcAddress = (m_glXGetProcAddressProc)dlsym(res->libgl, "glXGetProcAddress");
-    if (!res->m_glXGetProcAddress) {
-        PyErr_Format(PyExc_Exception, "glXGetProcAddress not found");
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(names);
+    PyObject * data = PyBytes_FromStringAndSize(NULL, count * sizeof(unsigned long long));
+    if (!data) {
+        Py_DECREF(names);
         return NULL;
     }
 
-    if (strcmp(mode, "detect")) {
-        res->libx11 = dlopen(libx11, RTLD_LAZY);
-        if (!res->libx11) {
-            PyErr_Format(PyExc_Exception, "(detect) %s not loaded", libx11);
+    unsigned long long * procs = (unsigned long long *)PyBytes_AS_STRING(data);
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        const char * method = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(names, i));
+        if (!method) {
+            Py_DECREF(names);
+            Py_DECREF(data);
             return NULL;
         }
+        procs[i] = (unsigned long long)(size_t)self->context->load(method);
+    }
 
-        res->m_XOpenDisplay = (m_XOpenDisplayProc)dlsym(res->libx11, "XOpenDisplay");
-        if (!res->m_XOpenDisplay) {
-            PyErr_Format(PyExc_Exception, "(detect) XOpenDisplay not found");
-            return NULL;
-        }
+    Py_DECREF(names);
+    return PyObject_CallFunction(array_type, "sN", "Q", data);
+}
 
-        res->m_XDefaultScreen = (m_XDefaultScreenProc)dlsym(res->libx11, "XDefaultScreen");
-        if (!res->m_XDefaultScreen) {
-            PyErr_Format(PyExc_Exception, "(detect) XDefaultScreen not found");
-            return NULL;
-        }
+// The GIL is only released when the driver has to be called, bindings that are already current return right away.
+// A failed enter() pushes no binding, __exit__ is not called when __enter__ raises.
+PyObject * GLContext_meth_enter(GLContext * self) {
+    bool success;
+    if (!self->context->enter_changes_binding()) {
+        success = self->context->enter();
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        success = self->context->enter();
+        Py_END_ALLOW_THREADS
+    }
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
-        res->m_XRootWindow = (m_XRootWindowProc)dlsym(res->libx11, "XRootWindow");
-        if (!res->m_XRootWindow) {
-            PyErr_Format(PyExc_Exception, "(detect) XRootWindow not found");
-            return NULL;
-        }
+PyObject * GLContext_meth_exit(GLContext * self, PyObject * const * args, Py_ssize_t nargs) {
+    if (!self->context->exit_changes_binding()) {
+        self->context->exit();
+        Py_RETURN_NONE;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    self->context->exit();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
 
-        res->m_XCreateColormap = (m_XCreateColormapProc)dlsym(res->libx11, "XCreateColormap");
-        if (!res->m_XCreateColormap) {
-            PyErr_Format(PyExc_Exception, "(detect) XCreateColormap not found");
-            return NULL;
-        }
+PyObject * GLContext_meth_fence(GLContext * self) {
+    glcontext::Fence * fence;
+    Py_BEGIN_ALLOW_THREADS
+    fence = self->context->fence();
+    Py_END_ALLOW_THREADS
 
-        res->m_XCreateWindow = (m_XCreateWindowProc)dlsym(res->libx11, "XCreateWindow");
-        if (!res->m_XCreateWindow) {
-            PyErr_Format(PyExc_Exception, "(detect) XCreateWindow not found");
-            return NULL;
-        }
+    if (!fence) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
 
-        res->m_XDestroyWindow = (m_XDestroyWindowProc)dlsym(res->libx11, "XDestroyWindow");
-        if (!res->m_XDestroyWindow) {
-            PyErr_Format(PyExc_Exception, "(detect) XDestroyWindow not found");
-            return NULL;
-        }
+    Fence * res = PyObject_New(Fence, Fence_type);
+    res->fence = fence;
+    Py_INCREF(self);
+    res->context = (PyObject *)self;
+    return (PyObject *)res;
+}
 
-        res->m_XCloseDisplay = (m_XCloseDisplayProc)dlsym(res->libx11, "XCloseDisplay");
-        if (!res->m_XCloseDisplay) {
-            PyErr_Format(PyExc_Exception, "(detect) XCloseDisplay not found");
-            return NULL;
-        }
+PyObject * GLContext_meth_frame_pacer(GLContext * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"frames", NULL};
 
-        res->m_XFree = (m_XFreeProc)dlsym(res->libx11, "XFree");
-        if (!res->m_XFree) {
-            PyErr_Format(PyExc_Exception, "(detect) XFree not found");
-            return NULL;
-        }
+    int frames = 2;
 
-        res->m_XSetErrorHandler = (m_XSetErrorHandlerProc)dlsym(res->libx11, "XSetErrorHandler");
-        if (!res->m_XSetErrorHandler) {
-            PyErr_Format(PyExc_Exception, "(detect) XSetErrorHandler not found");
-            return NULL;
-        }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i", keywords, &frames)) {
+        return NULL;
     }
 
-    if (!strcmp(mode, "detect")) {
-        res->standalone = false;
-        res->own_window = false;
+    if (frames < 1) {
+        PyErr_Format(PyExc_ValueError, "frames must be at least 1");
+        return NULL;
+    }
 
-        res->ctx = res->m_glXGetCurrentContext();
-        if (!res->ctx) {
-            PyErr_Format(PyExc_Exception, "(detect) glXGetCurrentContext: cannot detect OpenGL context");
-            return NULL;
-        }
+    FramePacer * res = PyObject_New(FramePacer, FramePacer_type);
+    res->pacer = new glcontext::FramePacer(self->context, frames);
+    Py_INCREF(self);
+    res->context = (PyObject *)self;
+    res->frames = frames;
+    return (PyObject *)res;
+}
 
-        res->wnd = res->m_glXGetCurrentDrawable();
-        if (!res->wnd) {
-            PyErr_Format(PyExc_Exception, "(detect) glXGetCurrentDrawable failed");
-            return NULL;
-        }
+PyObject * GLContext_meth_release(GLContext * self) {
+    Py_BEGIN_ALLOW_THREADS
+    self->context->release();
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
 
-        res->dpy = res->m_glXGetCurrentDisplay();
-        if (!res->dpy) {
-            PyErr_Format(PyExc_Exception, "(detect) glXGetCurrentDisplay failed");
-            return NULL;
-        }
+void GLContext_dealloc(GLContext * self) {
+    Py_BEGIN_ALLOW_THREADS
+    delete self->context;
+    Py_END_ALLOW_THREADS
+    Py_TYPE(self)->tp_free(self);
+}
 
-        res->fbc = NULL;
-        res->vi = NULL;
-        return res;
-    }
+PyMethodDef GLContext_methods[] = {
+    {"load", (PyCFunction)GLContext_meth_load, METH_O, NULL},
+    {"load_opengl_function", (PyCFunction)GLContext_meth_load, METH_O, NULL},
+    {"load_many", (PyCFunction)GLContext_meth_load_many, METH_O, NULL},
+    {"fence", (PyCFunction)GLContext_meth_fence, METH_NOARGS, NULL},
+    {"frame_pacer", (PyCFunction)GLContext_meth_frame_pacer, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"release", (PyCFunction)GLContext_meth_release, METH_NOARGS, NULL},
+    {"__enter__", (PyCFunction)GLContext_meth_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_FASTCALL, NULL},
+    {},
+};
 
-    if (!strcmp(mode, "share")) {
-        res->standalone = true;
-        res->own_window = false;
+PyObject * GLContext_get_release_behavior(GLContext * self, void * closure) {
+    return PyUnicode_FromString(self->context->release_behavior() == GLCONTEXT_RELEASE_NONE ? "none" : "flush");
+}
 
-        GLXContext ctx_share = res->m_glXGetCurrentContext();
-        if (!ctx_share) {
-            PyErr_Format(PyExc_Exception, "(share) glXGetCurrentContext: cannot detect OpenGL context");
-            return NULL;
-        }
+PyMemberDef GLContext_members[] = {
+    {"standalone", T_BOOL, offsetof(GLContext, standalone), READONLY, NULL},
+    {"no_error", T_BOOL, offsetof(GLContext, no_error), READONLY, NULL},
+    {},
+};
 
-        res->wnd = res->m_glXGetCurrentDrawable();
-        if (!res->wnd) {
-            PyErr_Format(PyExc_Exception, "(share) glXGetCurrentDrawable failed");
-            return NULL;
-        }
+PyGetSetDef GLContext_getset[] = {
+    {"release_behavior", (getter)GLContext_get_release_behavior, NULL, NULL, NULL},
+    {},
+};
 
-        res->dpy = res->m_glXGetCurrentDisplay();
-        if (!res->dpy) {
-            PyErr_Format(PyExc_Exception, "(share) glXGetCurrentDisplay failed");
-            return NULL;
-        }
+PyType_Slot GLContext_slots[] = {
+    {Py_tp_methods, GLContext_methods},
+    {Py_tp_members, GLContext_members},
+    {Py_tp_getset, GLContext_getset},
+    {Py_tp_dealloc, (void *)GLContext_dealloc},
+    {},
+};
 
-        int nelements = 0;
-        res->fbc = res->m_glXChooseFBConfig(res->dpy, res->m_XDefaultScreen(res->dpy), 0, &nelements);
+PyType_Spec GLContext_spec = {"x11.GLContext", sizeof(GLContext), 0, Py_TPFLAGS_DEFAULT, GLContext_slots};
 
-        if (!res->fbc) {
-            res->m_XCloseDisplay(res->dpy);
-            PyErr_Format(PyExc_Exception, "(share) glXChooseFBConfig failed");
-            return NULL;
-        }
+PyObject * Fence_meth_client_wait(Fence * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"timeout", NULL};
+
+    PyObject * timeout_arg = Py_None;
 
-        static int attribute_list[] = {
-            GLX_RGBA,
-            GLX_DOUBLEBUFFER,
-            GLX_RED_SIZE, 8,
-            GLX_GREEN_SIZE, 8,
-            GLX_BLUE_SIZE, 8,
-            GLX_DEPTH_SIZE, 24,
-            None,
-        };
-
-        res->vi = res->m_glXChooseVisual(res->dpy, res->m_XDefaultScreen(res->dpy), attribute_list);
-
-        if (!res->vi) {
-            res->m_XCloseDisplay(res->dpy);
-            PyErr_Format(PyExc_Exception, "(share) glXChooseVisual:  cannot choose visual");
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keywords, &timeout_arg)) {
+        return NULL;
+    }
+
+    double timeout = -1.0;
+    if (timeout_arg != Py_None) {
+        timeout = PyFloat_AsDouble(timeout_arg);
+        if (PyErr_Occurred()) {
             return NULL;
         }
+    }
 
-        res->m_XSetErrorHandler(SilentXErrorHandler);
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    status = self->fence->client_wait(timeout);
+    Py_END_ALLOW_THREADS
 
-        if (glversion) {
-            void (* proc)() = res->m_glXGetProcAddress((const unsigned char *)"glXCreateContextAttribsARB");
-            res->m_glXCreateContextAttribsARB = (m_glXCreateContextAttribsARBProc)proc;
-            if (!res->m_glXCreateContextAttribsARB) {
-                PyErr_Format(PyExc_Exception, "(share) glXCreateContextAttribsARB not found");
-                return NULL;
-            }
+    if (status < 0) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    return PyBool_FromLong(status);
+}
 
-            int attribs[] = {
-                GLX_CONTEXT_PROFILE_MASK, GLX_CONTEXT_CORE_PROFILE_BIT,
-                GLX_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
-                GLX_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
-                0, 0,
-            };
+PyObject * Fence_meth_server_wait(Fence * self) {
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = self->fence->server_wait();
+    Py_END_ALLOW_THREADS
 
-            res->ctx = res->m_glXCreateContextAttribsARB(res->dpy, *res->fbc, ctx_share, true, attribs);
-        } else {
-            res->ctx = res->m_glXCreateContext(res->dpy, res->vi, ctx_share, true);
-        }
-
-        if (!res->ctx) {
-            PyErr_Format(PyExc_Exception, "(share) cannot create context");
-            return NULL;
-        }
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
-        res->m_XSetErrorHandler(NULL);
+void Fence_dealloc(Fence * self) {
+    Py_BEGIN_ALLOW_THREADS
+    delete self->fence;
+    Py_END_ALLOW_THREADS
+    Py_DECREF(self->context);
+    Py_TYPE(self)->tp_free(self);
+}
 
-        if (!res->m_glXMakeCurrent(res->dpy, res->wnd, res->ctx)) {
-            PyErr_Format(PyExc_Exception, "(share) glXMakeCurrent failed");
-            return NULL;
-        }
+PyMethodDef Fence_methods[] = {
+    {"client_wait", (PyCFunction)Fence_meth_client_wait, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"server_wait", (PyCFunction)Fence_meth_server_wait, METH_NOARGS, NULL},
+    {},
+};
 
-        return res;
-    }
+PyMemberDef Fence_members[] = {
+    {"context", T_OBJECT_EX, offsetof(Fence, context), READONLY, NULL},
+    {},
+};
 
-    if (!strcmp(mode, "standalone")) {
-        res->standalone = true;
-        res->own_window = true;
+PyType_Slot Fence_slots[] = {
+    {Py_tp_methods, Fence_methods},
+    {Py_tp_members, Fence_members},
+    {Py_tp_dealloc, (void *)Fence_dealloc},
+    {},
+};
 
-        res->dpy = res->m_XOpenDisplay(NULL);
+PyType_Spec Fence_spec = {"x11.Fence", sizeof(Fence), 0, Py_TPFLAGS_DEFAULT, Fence_slots};
 
-        if (!res->dpy) {
-            res->dpy = res->m_XOpenDisplay(":0.0");
-        }
+PyObject * FramePacer_meth_begin_frame(FramePacer * self) {
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = self->pacer->begin_frame();
+    Py_END_ALLOW_THREADS
 
-        if (!res->dpy) {
-            PyErr_Format(PyExc_Exception, "(standalone) XOpenDisplay: cannot open display");
-            return NULL;
-        }
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
-        int nelements = 0;
-        res->fbc = res->m_glXChooseFBConfig(res->dpy, res->m_XDefaultScreen(res->dpy), 0, &nelements);
+PyObject * FramePacer_meth_end_frame(FramePacer * self) {
+    bool success;
+    Py_BEGIN_ALLOW_THREADS
+    success = self->pacer->end_frame();
+    Py_END_ALLOW_THREADS
 
-        if (!res->fbc) {
-            res->m_XCloseDisplay(res->dpy);
-            PyErr_Format(PyExc_Exception, "(standalone) glXChooseFBConfig failed");
-            return NULL;
-        }
+    if (!success) {
+        PyErr_SetString(PyExc_Exception, glcontext::last_error());
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
 
-        static int attribute_list[] = {
-            GLX_RGBA,
-            GLX_DOUBLEBUFFER,
-            GLX_RED_SIZE, 8,
-            GLX_GREEN_SIZE, 8,
-            GLX_BLUE_SIZE, 8,
-            GLX_DEPTH_SIZE, 24,
-            None,
-        };
-
-        res->vi = res->m_glXChooseVisual(res->dpy, res->m_XDefaultScreen(res->dpy), attribute_list);
-
-        if (!res->vi) {
-            res->m_XCloseDisplay(res->dpy);
-            PyErr_Format(PyExc_Exception, "(standalone) glXChooseVisual: cannot choose visual");
-            return NULL;
-        }
+// A frame that raised inside the with block is still fenced, the commands it submitted count against the limit.
+PyObject * FramePacer_meth_exit(FramePacer * self, PyObject * const * args, Py_ssize_t nargs) {
+    return FramePacer_meth_end_frame(self);
+}
 
-        XSetWindowAttributes swa;
-        swa.colormap = res->m_XCreateColormap(res->dpy, res->m_XRootWindow(res->dpy, res->vi->screen), res->vi->visual, AllocNone);
-        swa.border_pixel = 0;
-        swa.event_mask = StructureNotifyMask;
+PyObject * FramePacer_get_frames_in_flight(FramePacer * self, void * closure) {
+    int frames;
+    Py_BEGIN_ALLOW_THREADS
+    frames = self->pacer->frames_in_flight();
+    Py_END_ALLOW_THREADS
+    return PyLong_FromLong(frames);
+}
 
-        res->wnd = res->m_XCreateWindow(
-            res->dpy, res->m_XRootWindow(res->dpy, res->vi->screen), 0, 0, 1, 1, 0, res->vi->depth, InputOutput,
-            res->vi->visual, CWBorderPixel | CWColormap | CWEventMask, &swa
-        );
+void FramePacer_dealloc(FramePacer * self) {
+    Py_BEGIN_ALLOW_THREADS
+    delete self->pacer;
+    Py_END_ALLOW_THREADS
+    Py_DECREF(self->context);
+    Py_TYPE(self)->tp_free(self);
+}
 
-        if (!res->wnd) {
-            res->m_XCloseDisplay(res->dpy);
-            PyErr_Format(PyExc_Exception, "(standalone) XCreateWindow: cannot create window");
-            return NULL;
-        }
+PyMethodDef FramePacer_methods[] = {
+    {"begin_frame", (PyCFunction)FramePacer_meth_begin_frame, METH_NOARGS, NULL},
+    {"end_frame", (PyCFunction)FramePacer_meth_end_frame, METH_NOARGS, NULL},
+    {"__enter__", (PyCFunction)FramePacer_meth_begin_frame, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)FramePacer_meth_exit, METH_FASTCALL, NULL},
+    {},
+};
 
-        res->m_XSetErrorHandler(SilentXErrorHandler);
+PyMemberDef FramePacer_members[] = {
+    {"context", T_OBJECT_EX, offsetof(FramePacer, context), READONLY, NULL},
+    {"frames", T_INT, offsetof(FramePacer, frames), READONLY, NULL},
+    {},
+};
 
-        if (glversion) {
-            void (* proc)() = res->m_glXGetProcAddress((const unsigned char *)"glXCreateContextAttribsARB");
-            res->m_glXCreateContextAttribsARB = (m_glXCreateContextAttribsARBProc)proc;
-            if (!res->m_glXCreateContextAttribsARB) {
-                PyErr_Format(PyExc_Exception, "(standalone) glXCreateContextAttribsARB not found");
-                return NULL;
-            }
+PyGetSetDef FramePacer_getset[] = {
+    {"frames_in_flight", (getter)FramePacer_get_frames_in_flight, NULL, NULL, NULL},
+    {},
+};
 
-            int attribs[] = {
-                GLX_CONTEXT_PROFILE_MASK, GLX_CONTEXT_CORE_PROFILE_BIT,
-                GLX_CONTEXT_MAJOR_VERSION, glversion / 100 % 10,
-                GLX_CONTEXT_MINOR_VERSION, glversion / 10 % 10,
-                0, 0,
-            };
+PyType_Slot FramePacer_slots[] = {
+    {Py_tp_methods, FramePacer_methods},
+    {Py_tp_members, FramePacer_members},
+    {Py_tp_getset, FramePacer_getset},
+    {Py_tp_dealloc, (void *)FramePacer_dealloc},
+    {},
+};
 
-            res->ctx = res->m_glXCreateContextAttribsARB(res->dpy, *res->fbc, NULL, true, attribs);
-        } else {
-            res->ctx = res->m_glXCreateContext(res->dpy, res->vi, NULL, true);
-        }
+PyType_Spec FramePacer_spec = {"x11.FramePacer", sizeof(FramePacer), 0, Py_TPFLAGS_DEFAULT, FramePacer_slots};
 
-        if (!res->ctx) {
-            PyErr_Format(PyExc_Exception, "(standalone) cannot create context");
-            return NULL;
-        }
+PyObject * meth_configure_pool(PyObject * self, PyObject * args, PyObject * kwargs) {
+    static char * keywords[] = {"max_size", "max_idle", NULL};
 
-        res->m_XSetErrorHandler(NULL);
+    int max_size = 0;
+    double max_idle = 0.0;
 
-        if (!res->m_glXMakeCurrent(res->dpy, res->wnd, res->ctx)) {
-            PyErr_Format(PyExc_Exception, "(standalone) glXMakeCurrent failed");
-            return NULL;
-        }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|id", keywords, &max_size, &max_idle)) {
+        return NULL;
+    }
 
-        return res;
+    if (max_size < 0) {
+        PyErr_Format(PyExc_ValueError, "max_size must not be negative");
+        return NULL;
     }
 
-    PyErr_Format(PyExc_Exception, "unknown mode");
-    return NULL;
+    Py_BEGIN_ALLOW_THREADS
+    glcontext::configure_x11_pool(max_size, max_idle);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
 }
 
-PyObject * GLContext_meth_load(GLContext * self, PyObject * arg) {
-    const char * method = PyUnicode_AsUTF8(arg);
-    void * proc = (void *)dlsym(self->libgl, method);
-    if (!proc) {
-        proc = (void *)self->m_glXGetProcAddress((const unsigned char *)method);
-    }
-    return PyLong_FromVoidPtr(proc);
+PyObject * meth_pool_stats(PyObject * self) {
+    glcontext::PoolStats stats;
+    Py_BEGIN_ALLOW_THREADS
+    stats = glcontext::x11_pool_stats();
+    Py_END_ALLOW_THREADS
+    return Py_BuildValue(
+        "{sisisLsLsL}",
+        "size", stats.size,
+        "max_size", stats.max_size,
+        "hits", stats.hits,
+        "misses", stats.misses,
+        "evictions", stats.evictions
+    );
 }
 
-PyObject * GLContext_meth_enter(GLContext * self) {
-    self->old_display = (void *)self->m_glXGetCurrentDisplay();
-    self->old_window = (void *)self->m_glXGetCurrentDrawable();
-    self->old_context = (void *)self->m_glXGetCurrentContext();
-    self->m_glXMakeCurrent(self->dpy, self->wnd, self->ctx);
-    Py_RETURN_NONE;
+int capi_make_current(PyObject * context) {
+    return ((GLContext *)context)->context->enter();
 }
 
-PyObject * GLContext_meth_exit(GLContext * self) {
-    self->m_glXMakeCurrent((Display *)self->old_display, (Window)self->old_window, (GLXContext)self->old_context);    
-    Py_RETURN_NONE;
+int capi_done_current(PyObject * context) {
+    return ((GLContext *)context)->context->exit();
 }
 
-PyObject * GLContext_meth_release(GLContext * self) {
-    if (self->standalone) {
-        self->m_glXMakeCurrent(self->dpy, None, NULL);
-        self->m_glXDestroyContext(self->dpy, self->ctx);
-    }
-    if (self->own_window) {
-        self->m_XDestroyWindow(self->dpy, self->wnd);
-        self->m_XCloseDisplay(self->dpy);
-    }
-    if (self->fbc) {
-        self->m_XFree(self->fbc);
-        self->fbc = NULL;
-    }
-    if (self->vi) {
-        self->m_XFree(self->vi);
-        self->vi = NULL;
-    }
-    Py_RETURN_NONE;
+void * capi_get_proc_address(PyObject * context, const char * name) {
+    return ((GLContext *)context)->context->load(name);
 }
 
-void GLContext_dealloc(GLContext * self) {
-    Py_TYPE(self)->tp_free(self);
+void capi_load_many(PyObject * context, const char * const * names, int count, void ** procs) {
+    for (int i = 0; i < count; ++i) {
+        procs[i] = ((GLContext *)context)->context->load(names[i]);
+    }
 }
 
-PyMethodDef GLContext_methods[] = {
-    {"load", (PyCFunction)GLContext_meth_load, METH_O, NULL},
-    {"load_opengl_function", (PyCFunction)GLContext_meth_load, METH_O, NULL},
-    {"release", (PyCFunction)GLContext_meth_release, METH_NOARGS, NULL},
-    {"__enter__", (PyCFunction)GLContext_meth_enter, METH_NOARGS, NULL},
-    {"__exit__", (PyCFunction)GLContext_meth_exit, METH_VARARGS, NULL},
-    {},
-};
-
-PyMemberDef GLContext_members[] = {
-    {"standalone", T_BOOL, offsetof(GLContext, standalone), READONLY, NULL},
-    {},
-};
+void capi_release(PyObject * context) {
+    ((GLContext *)context)->context->release();
+}
 
-PyType_Slot GLContext_slots[] = {
-    {Py_tp_methods, GLContext_methods},
-    {Py_tp_members, GLContext_members},
-    {Py_tp_dealloc, (void *)GLContext_dealloc},
-    {},
+GLContextCAPI c_api = {
+    GLCONTEXT_CAPI_VERSION,
+    capi_make_current,
+    capi_done_current,
+    capi_get_proc_address,
+    capi_load_many,
+    capi_release,
 };
 
-PyType_Spec GLContext_spec = {"x11.GLContext", sizeof(GLContext), 0, Py_TPFLAGS_DEFAULT, GLContext_slots};
-
 PyMethodDef module_methods[] = {
     {"create_context", (PyCFunction)meth_create_context, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"configure_pool", (PyCFunction)meth_configure_pool, METH_VARARGS | METH_KEYWORDS, NULL},
+    {"pool_stats", (PyCFunction)meth_pool_stats, METH_NOARGS, NULL},
     {},
 };
 
@@ -513,7 +531,18 @@ PyModuleDef module_def = {PyModuleDef_HEAD_INIT, "x11", NULL, -1, module_methods
 
 extern "C" PyObject * PyInit_x11() {
     PyObject * module = PyModule_Create(&module_def);
+    PyObject * array = PyImport_ImportModule("array");
+    if (!array) {
+        return NULL;
+    }
+    array_type = PyObject_GetAttrString(array, "array");
+    Py_DECREF(array);
     GLContext_type = (PyTypeObject *)PyType_FromSpec(&GLContext_spec);
     PyModule_AddObject(module, "GLContext", (PyObject *)GLContext_type);
+    Fence_type = (PyTypeObject *)PyType_FromSpec(&Fence_spec);
+    PyModule_AddObject(module, "Fence", (PyObject *)Fence_type);
+    FramePacer_type = (PyTypeObject *)PyType_FromSpec(&FramePacer_spec);
+    PyModule_AddObject(module, "FramePacer", (PyObject *)FramePacer_type);
+    PyModule_AddObject(module, "c_api", PyCapsule_New(&c_api, "glcontext.x11.c_api", NULL));
     return module;
 }
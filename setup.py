@@ -23,14 +23,14 @@ wgl = Extension(
 
 x11 = Extension(
     name='glcontext.x11',
-    sources=['glcontext/x11.cpp'],
+    sources=['glcontext/x11.cpp', 'glcontext/core/context.cpp', 'glcontext/core/x11.cpp'],
     extra_compile_args=['-fpermissive'],
     libraries=['dl'],
 )
 
 egl = Extension(
     name='glcontext.egl',
-    sources=['glcontext/egl.cpp'],
+    sources=['glcontext/egl.cpp', 'glcontext/core/context.cpp', 'glcontext/core/egl.cpp'],
     extra_compile_args=['-fpermissive'],
     libraries=['dl'],
 )
@@ -67,7 +67,7 @@ if target == 'darwin':
 darwin = Extension(
     name='glcontext.darwin',
     sources=['glcontext/darwin.cpp'],
-    extra_compile_args=['-fpermissive', '-Wno-deprecated-declarations'],
+    extra_compile_args=['-fpermissive', '-Wno-deprecated-declarations', '-std=c++11'],
     extra_link_args=['-framework', 'OpenGL', '-Wno-deprecated'],
 )
 
@@ -89,6 +89,7 @@ setup(
     license='MIT',
     platforms=['any'],
     packages=['glcontext'],
+    package_data={'glcontext': ['glcontext.hpp']},
     ext_modules=ext_modules[target],
     classifiers=[
         'Development Status :: 5 - Production/Stable',
@@ -0,0 +1,47 @@
+/* Uses the core library through its C interface, without Python. */
+
+#include <stdio.h>
+
+#include "glcontext.h"
+
+int main() {
+    glcontext_context * context = glcontext_create_egl("standalone", NULL, NULL, 330, 0);
+    if (!context) {
+        printf("skipped: %s\n", glcontext_last_error());
+        return 77;
+    }
+
+    if (!glcontext_load(context, "glEnable")) {
+        printf("glEnable not found\n");
+        return 1;
+    }
+
+    glcontext_context * other = glcontext_create_egl("standalone", NULL, NULL, 330, 0);
+    if (!other) {
+        printf("%s\n", glcontext_last_error());
+        return 1;
+    }
+
+    if (!glcontext_enter(context) || !glcontext_enter(other) || !glcontext_exit(other) || !glcontext_exit(context)) {
+        printf("make current failed\n");
+        return 1;
+    }
+
+    glcontext_fence * fence = glcontext_create_fence(context);
+    if (!fence || glcontext_fence_client_wait(fence, 5.0) != 1) {
+        printf("fence failed: %s\n", glcontext_last_error());
+        return 1;
+    }
+    glcontext_fence_destroy(fence);
+
+    if (glcontext_create_egl("unknown", NULL, NULL, 330, 0) || !glcontext_last_error()[0]) {
+        printf("unknown mode not reported\n");
+        return 1;
+    }
+
+    glcontext_release(other);
+    glcontext_destroy(other);
+    glcontext_release(context);
+    glcontext_destroy(context);
+    return 0;
+}
@@ -30,6 +30,13 @@ class ContextTestCase(TestCase):
         self.assertIsInstance(ptr, int)
         self.assertGreater(ptr, 0)
 
+        # Ensure bulk method loading works
+        if hasattr(ctx, 'load_many'):
+            ptrs = ctx.load_many(['glEnable', 'glDisable'])
+            self.assertEqual(len(ptrs), 2)
+            self.assertEqual(ptrs[0], ptr)
+            self.assertGreater(ptrs[1], 0)
+
         # Load non-existent gl method
         # NOTE: Disabled for now since x11 returns positive values
         #       for non-existent methods
@@ -0,0 +1,497 @@
+import ctypes
+import subprocess
+import sys
+import threading
+from unittest import TestCase, skipUnless
+import glcontext
+
+try:
+    from glcontext import egl
+except ImportError:
+    egl = None
+
+
+@skipUnless(egl, 'egl backend not available')
+class EGLTestCase(TestCase):
+
+    def create(self, **kwargs):
+        return glcontext.get_backend_by_name('egl')(mode='standalone', glversion=330, **kwargs)
+
+    def test_pool(self):
+        """Released contexts are recycled when pooling is enabled"""
+        egl.configure_pool(max_size=2)
+        try:
+            start = egl.pool_stats()
+            for i in range(10):
+                ctx = self.create()
+                with ctx:
+                    self.assertGreater(ctx.load('glEnable'), 0)
+                ctx.release()
+
+            stats = egl.pool_stats()
+            self.assertEqual(stats['size'], 1)
+            self.assertGreaterEqual(stats['hits'] - start['hits'], 9)
+        finally:
+            egl.configure_pool(max_size=0)
+
+        self.assertEqual(egl.pool_stats()['size'], 0)
+
+    def test_release_bound_elsewhere(self):
+        """A context released while another thread has it current is destroyed instead of pooled"""
+        egl.configure_pool(max_size=2)
+        try:
+            created = threading.Event()
+            done = threading.Event()
+            contexts = []
+
+            def worker():
+                # standalone contexts are current on the creating thread
+                contexts.append(self.create())
+                created.set()
+                done.wait()
+
+            thread = threading.Thread(target=worker)
+            thread.start()
+            created.wait()
+
+            try:
+                size = egl.pool_stats()['size']
+                contexts[0].release()
+                self.assertEqual(egl.pool_stats()['size'], size)
+
+                ctx = self.create()
+                with ctx:
+                    self.assertGreater(ctx.load('glEnable'), 0)
+                ctx.release()
+            finally:
+                done.set()
+                thread.join()
+        finally:
+            egl.configure_pool(max_size=0)
+
+    def test_nested_enter(self):
+        """Leaving a nested with block restores the outer context"""
+        ctx1 = self.create()
+        ctx2 = self.create()
+        get_current = ctypes.CFUNCTYPE(ctypes.c_void_p)(ctx1.load('eglGetCurrentContext'))
+
+        before = get_current()
+        with ctx1:
+            outer = get_current()
+            with ctx2:
+                inner = get_current()
+                self.assertNotEqual(inner, outer)
+                with ctx1:
+                    self.assertEqual(get_current(), outer)
+                self.assertEqual(get_current(), inner)
+            self.assertEqual(get_current(), outer)
+        self.assertEqual(get_current(), before)
+
+        ctx1.release()
+        ctx2.release()
+
+    def test_enter_released(self):
+        """Entering a released context raises and keeps the current binding"""
+        ctx1 = self.create()
+        ctx2 = self.create()
+        get_current = ctypes.CFUNCTYPE(ctypes.c_void_p)(ctx1.load('eglGetCurrentContext'))
+        ctx2.release()
+
+        with ctx1:
+            outer = get_current()
+            with self.assertRaises(Exception):
+                with ctx2:
+                    pass
+            self.assertEqual(get_current(), outer)
+        ctx1.release()
+
+    def test_display_shared_between_libraries(self):
+        """Releasing the last context of one libGL keeps the display of another libGL initialized"""
+        import ctypes.util
+        if not ctypes.util.find_library('OpenGL'):
+            self.skipTest('libOpenGL not available')
+
+        ctx = self.create(libgl='libGL.so.1')
+        other = self.create(libgl='libOpenGL.so.0')
+        other.release()
+
+        get_string = ctypes.CFUNCTYPE(ctypes.c_char_p, ctypes.c_uint)(ctx.load('glGetString'))
+        with ctx:
+            self.assertTrue(get_string(0x1F01))
+        ctx.release()
+
+    def test_threads(self):
+        """Contexts can be created and released from several threads at once"""
+        errors = []
+
+        def worker():
+            try:
+                for i in range(5):
+                    ctx = self.create()
+                    with ctx:
+                        self.assertGreater(ctx.load('glEnable'), 0)
+                    ctx.release()
+            except Exception as ex:
+                errors.append(ex)
+
+        threads = [threading.Thread(target=worker) for i in range(4)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        self.assertEqual(errors, [])
+
+    def test_create_async(self):
+        """Contexts created in the background can be made current on the calling thread"""
+        ctx = glcontext.create_context_async('egl', glversion=330).result(timeout=30)
+        get_current = ctypes.CFUNCTYPE(ctypes.c_void_p)(ctx.load('eglGetCurrentContext'))
+        before = get_current()
+        with ctx:
+            self.assertNotEqual(get_current(), before)
+            self.assertGreater(ctx.load('glEnable'), 0)
+        ctx.release()
+
+    def test_c_api(self):
+        """The c_api capsule switches contexts without the Python methods"""
+
+        class CAPI(ctypes.Structure):
+            _fields_ = [
+                ('version', ctypes.c_int),
+                ('make_current', ctypes.CFUNCTYPE(ctypes.c_int, ctypes.py_object)),
+                ('done_current', ctypes.CFUNCTYPE(ctypes.c_int, ctypes.py_object)),
+                ('get_proc_address', ctypes.CFUNCTYPE(ctypes.c_void_p, ctypes.py_object, ctypes.c_char_p)),
+                ('load_many', ctypes.c_void_p),
+                ('release', ctypes.CFUNCTYPE(None, ctypes.py_object)),
+            ]
+
+        get_pointer = ctypes.pythonapi.PyCapsule_GetPointer
+        get_pointer.restype = ctypes.c_void_p
+        get_pointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+        api = CAPI.from_address(get_pointer(egl.c_api, b'glcontext.egl.c_api'))
+        self.assertEqual(api.version, 1)
+
+        ctx = self.create()
+        get_current = ctypes.CFUNCTYPE(ctypes.c_void_p)(ctx.load('eglGetCurrentContext'))
+        other = self.create()
+        with other:
+            outer = get_current()
+            self.assertEqual(api.make_current(ctx), 1)
+            self.assertNotEqual(get_current(), outer)
+            self.assertEqual(api.get_proc_address(ctx, b'glEnable'), ctx.load('glEnable'))
+            self.assertEqual(api.done_current(ctx), 1)
+            self.assertEqual(get_current(), outer)
+        api.release(ctx)
+        other.release()
+
+    def test_share_group(self):
+        """Objects created in one context of a share group are visible in the others"""
+        first, second, third = egl.create_share_group(3, glversion=330)
+        self.assertTrue(all(ctx.standalone for ctx in (first, second, third)))
+
+        load = first.load
+        gen_buffers = ctypes.CFUNCTYPE(None, ctypes.c_int, ctypes.POINTER(ctypes.c_uint))(load('glGenBuffers'))
+        bind_buffer = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint)(load('glBindBuffer'))
+        is_buffer = ctypes.CFUNCTYPE(ctypes.c_ubyte, ctypes.c_uint)(load('glIsBuffer'))
+        finish = ctypes.CFUNCTYPE(None)(load('glFinish'))
+
+        buffer = ctypes.c_uint()
+        with second:
+            gen_buffers(1, ctypes.byref(buffer))
+            bind_buffer(0x8892, buffer.value)
+            bind_buffer(0x8892, 0)
+            finish()
+
+        with third:
+            self.assertTrue(is_buffer(buffer.value))
+
+        for ctx in (first, second, third):
+            ctx.release()
+
+        with self.assertRaises(ValueError):
+            egl.create_share_group(0)
+
+    def test_fence(self):
+        """A fence created in one context is waited on in another context of the share group"""
+        producer, consumer = egl.create_share_group(2, glversion=330)
+
+        load = producer.load
+        gen_buffers = ctypes.CFUNCTYPE(None, ctypes.c_int, ctypes.POINTER(ctypes.c_uint))(load('glGenBuffers'))
+        bind_buffer = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint)(load('glBindBuffer'))
+        is_buffer = ctypes.CFUNCTYPE(ctypes.c_ubyte, ctypes.c_uint)(load('glIsBuffer'))
+
+        buffer = ctypes.c_uint()
+        with producer:
+            gen_buffers(1, ctypes.byref(buffer))
+            bind_buffer(0x8892, buffer.value)
+            bind_buffer(0x8892, 0)
+            fence = producer.fence()
+
+        self.assertIs(fence.context, producer)
+        self.assertTrue(fence.client_wait(timeout=5.0))
+
+        def consume():
+            with consumer:
+                fence.server_wait()
+                return is_buffer(buffer.value)
+
+        thread = threading.Thread(target=lambda: results.append(consume()))
+        results = []
+        thread.start()
+        thread.join()
+        self.assertEqual(results, [1])
+
+        consumer.release()
+        producer.release()
+        with self.assertRaises(Exception):
+            producer.fence()
+
+    def test_gpu_done(self):
+        """gpu_done() resolves on the event loop once the submitted commands completed"""
+        import asyncio
+
+        ctx = self.create()
+
+        async def render():
+            with ctx:
+                return await asyncio.wait_for(ctx.gpu_done(), timeout=30)
+
+        self.assertIsNone(asyncio.run(render()))
+        ctx.release()
+
+    def test_frame_pacer(self):
+        """The frame pacer keeps at most the requested number of frames in flight"""
+        ctx = self.create()
+        clear = ctypes.CFUNCTYPE(None, ctypes.c_uint)(ctx.load('glClear'))
+        pacer = ctx.frame_pacer(frames=2)
+        self.assertEqual(pacer.frames, 2)
+
+        for _ in range(10):
+            with pacer:
+                clear(0x4000)
+            self.assertLessEqual(pacer.frames_in_flight, 2)
+
+        with self.assertRaises(ValueError):
+            ctx.frame_pacer(frames=0)
+
+        del pacer
+        ctx.release()
+
+    def test_frame_pacer_unbound(self):
+        """The frame pacer waits for its frames without the context current on the calling thread"""
+        # only the first context of a share group is made current on creation
+        share_group = egl.create_share_group(2, glversion=330)
+        ctx = share_group[1]
+        clear = ctypes.CFUNCTYPE(None, ctypes.c_uint)(ctx.load('glClear'))
+        get_current = ctypes.CFUNCTYPE(ctypes.c_void_p)(ctx.load('eglGetCurrentContext'))
+        pacer = ctx.frame_pacer(frames=2)
+        results = []
+
+        def worker():
+            try:
+                for _ in range(10):
+                    with pacer:
+                        with ctx:
+                            clear(0x4000)
+                    results.append((pacer.frames_in_flight <= 2, get_current()))
+            except Exception as ex:
+                results.append(ex)
+
+        thread = threading.Thread(target=worker)
+        thread.start()
+        thread.join()
+        self.assertEqual(results, [(True, None)] * 10)
+
+        del pacer
+        for ctx in share_group:
+            ctx.release()
+
+    def test_auto_device(self):
+        """Automatically placed contexts are counted on their device"""
+        start = sum(egl.live_contexts())
+        contexts = [self.create(device_index='auto', placement=placement) for placement in ('least_contexts', 'round_robin', 'prefer_hardware')]
+        self.assertEqual(sum(egl.live_contexts()), start + 3)
+
+        for ctx in contexts:
+            ctx.release()
+        self.assertEqual(sum(egl.live_contexts()), start)
+
+        with self.assertRaises(ValueError):
+            self.create(device_index='auto', placement='unknown')
+
+    def test_auto_device_processes(self):
+        """Worker processes with one automatically placed context each start on different devices"""
+        script = (
+            'import os\n'
+            'from glcontext import egl\n'
+            'ctx = egl.create_context(mode="standalone", glversion=330, device_index="auto", placement="{}")\n'
+            'print(os.getpid(), egl.live_contexts().index(1))\n'
+        )
+        num_devices = len(egl.devices())
+        for placement in ('round_robin', 'least_contexts'):
+            workers = [subprocess.Popen([sys.executable, '-c', script.format(placement)], stdout=subprocess.PIPE, universal_newlines=True) for i in range(4)]
+            placed = [tuple(int(x) for x in worker.communicate(timeout=60)[0].split()) for worker in workers]
+            for pid, device in placed:
+                self.assertEqual(device, pid % num_devices)
+            if len({pid % num_devices for pid, device in placed}) > 1:
+                self.assertGreater(len({device for pid, device in placed}), 1)
+
+    def test_devices(self):
+        """The device inventory is queried once and describes every device"""
+        devices = egl.devices()
+        self.assertEqual(egl.devices(), devices)
+        devices[0]['index'] = -1
+        self.assertEqual(egl.devices()[0]['index'], 0)
+        devices = egl.devices()
+        self.assertGreater(len(devices), 0)
+        for index, device in enumerate(devices):
+            self.assertEqual(device['index'], index)
+            self.assertIsInstance(device['extensions'], frozenset)
+            self.assertIn('device', device['platforms'])
+            self.assertEqual(device['software'], 'EGL_MESA_device_software' in device['extensions'])
+
+    def test_config(self):
+        """Contexts without a config or with a custom config are not pooled"""
+        egl.configure_pool(max_size=4)
+        try:
+            for config in ['none', {'depth_size': 0, 'stencil_size': 0}]:
+                ctx = egl.create_context(mode='standalone', glversion=330, config=config)
+                with ctx:
+                    self.assertTrue(ctx.load('glGetString'))
+                ctx.release()
+                self.assertEqual(egl.pool_stats()['size'], 0)
+
+            with self.assertRaises(KeyError):
+                egl.create_context(mode='standalone', config={'depth': 24})
+        finally:
+            egl.configure_pool()
+
+    def test_no_error(self):
+        """No-error contexts are pooled apart from regular ones"""
+        egl.configure_pool(max_size=4)
+        try:
+            hits = egl.pool_stats()['hits']
+            ctx = egl.create_context(mode='standalone', glversion=330, no_error=True)
+            no_error = ctx.no_error
+            ctx.release()
+
+            # matched on the requested options, also when the driver fell back to a regular context
+            ctx = egl.create_context(mode='standalone', glversion=330)
+            self.assertFalse(ctx.no_error)
+            self.assertEqual(egl.pool_stats()['hits'] - hits, 0)
+            ctx.release()
+
+            ctx = egl.create_context(mode='standalone', glversion=330, no_error=True)
+            self.assertEqual(ctx.no_error, no_error)
+            self.assertEqual(egl.pool_stats()['hits'] - hits, 1)
+            ctx.release()
+
+            share_group = egl.create_share_group(2, glversion=330, no_error=True)
+            self.assertEqual([ctx.no_error for ctx in share_group], [no_error, no_error])
+            for ctx in share_group:
+                ctx.release()
+        finally:
+            egl.configure_pool()
+
+    def test_release_behavior(self):
+        """Contexts without flush on release are reported and validated"""
+        share_group = egl.create_share_group(2, glversion=330, release_behavior='none')
+        self.assertIn(share_group[0].release_behavior, ('none', 'flush'))
+        for ctx in share_group:
+            ctx.release()
+
+        egl.configure_pool(max_size=4)
+        try:
+            hits = egl.pool_stats()['hits']
+            ctx = egl.create_context(mode='standalone', glversion=330, release_behavior='none')
+            release_behavior = ctx.release_behavior
+            ctx.release()
+
+            ctx = egl.create_context(mode='standalone', glversion=330)
+            self.assertEqual(ctx.release_behavior, 'flush')
+            self.assertEqual(egl.pool_stats()['hits'] - hits, 0)
+            ctx.release()
+
+            ctx = egl.create_context(mode='standalone', glversion=330, release_behavior='none')
+            self.assertEqual(ctx.release_behavior, release_behavior)
+            self.assertEqual(egl.pool_stats()['hits'] - hits, 1)
+            ctx.release()
+        finally:
+            egl.configure_pool()
+
+        with self.assertRaises(ValueError):
+            egl.create_context(mode='standalone', release_behavior='never')
+
+    def test_surfaceless(self):
+        """Surfaceless contexts share objects and are created through the named backend"""
+        backend = glcontext.get_backend_by_name('surfaceless')
+        ctx = backend(mode='standalone', glversion=330)
+        self.assertTrue(ctx.standalone)
+        shared = egl.create_context(mode='surfaceless', glversion=330, share=ctx)
+        with shared:
+            self.assertTrue(shared.load('glGetString'))
+        shared.release()
+        ctx.release()
+
+    def test_executor(self):
+        """Worker contexts share objects with the executor context"""
+        from glcontext.executor import ContextExecutor
+
+        with ContextExecutor(workers=2, glversion=330) as executor:
+            load = executor.context.load
+            gen_buffers = ctypes.CFUNCTYPE(None, ctypes.c_int, ctypes.POINTER(ctypes.c_uint))(load('glGenBuffers'))
+            bind_buffer = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint)(load('glBindBuffer'))
+            is_buffer = ctypes.CFUNCTYPE(ctypes.c_ubyte, ctypes.c_uint)(load('glIsBuffer'))
+            finish = ctypes.CFUNCTYPE(None)(load('glFinish'))
+
+            def create_buffer():
+                buffer = ctypes.c_uint()
+                gen_buffers(1, ctypes.byref(buffer))
+                bind_buffer(0x8892, buffer.value)
+                bind_buffer(0x8892, 0)
+                finish()
+                return buffer.value
+
+            buffer = executor.submit(create_buffer).result(timeout=30)
+            with executor.context:
+                self.assertTrue(is_buffer(buffer))
+
+    def test_executor_broken(self):
+        """A worker that cannot make its context current fails the pending work instead of hanging"""
+        from concurrent.futures import BrokenExecutor
+        from unittest import mock
+        from glcontext.executor import ContextExecutor
+
+        create_share_group = egl.create_share_group
+
+        def broken_share_group(count, **kwargs):
+            contexts = create_share_group(count, **kwargs)
+            contexts[1].release()
+            return contexts
+
+        with mock.patch.object(egl, 'create_share_group', broken_share_group):
+            executor = ContextExecutor(workers=1, glversion=330)
+
+        try:
+            future = executor.submit(pow, 2, 10)
+        except BrokenExecutor:
+            pass
+        else:
+            with self.assertRaises(BrokenExecutor):
+                future.result(timeout=30)
+
+        with self.assertRaises(BrokenExecutor):
+            executor.submit(pow, 2, 10)
+        executor.shutdown(wait=True)
+
+    def test_executor_shutdown_nowait(self):
+        """The executor context is released by the last worker without waiting"""
+        from glcontext.executor import ContextExecutor
+
+        start = sum(egl.live_contexts())
+        executor = ContextExecutor(workers=2, glversion=330)
+        self.assertEqual(sum(egl.live_contexts()), start + 3)
+        executor.shutdown(wait=False)
+        for thread in executor._threads:
+            thread.join()
+        self.assertEqual(sum(egl.live_contexts()), start)
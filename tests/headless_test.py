@@ -0,0 +1,131 @@
+import ctypes
+import sys
+import threading
+from unittest import TestCase, skipUnless
+
+try:
+    from glcontext import headless
+except ImportError:
+    headless = None
+
+try:
+    libegl = ctypes.CDLL('libEGL.so.1')
+    libegl.eglGetCurrentContext.restype = ctypes.c_void_p
+except OSError:
+    libegl = None
+
+
+def current_context():
+    return libegl.eglGetCurrentContext()
+
+
+@skipUnless(headless and libegl, 'headless module not available')
+class HeadlessTestCase(TestCase):
+
+    def test_device(self):
+        """Devices are opened once per index"""
+        device = headless.device(0)
+        self.assertIs(headless.device(0), device)
+        self.assertIs(headless.device(index=0), device)
+        self.assertEqual(device.index, 0)
+        self.assertEqual(headless.devices()[0]['device'], 0)
+
+        with self.assertRaises(ValueError):
+            headless.device(len(headless.devices()))
+
+    def test_share(self):
+        """Contexts created with share see the objects of the share context"""
+        device = headless.device(0)
+        ctx1 = device.create_context(glversion=330)
+        ctx2 = device.create_context(glversion=330, share=ctx1)
+        self.assertIs(ctx2.device, device)
+
+        gen_buffers = ctypes.CFUNCTYPE(None, ctypes.c_int, ctypes.POINTER(ctypes.c_uint))(ctx1.load('glGenBuffers'))
+        bind_buffer = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint)(ctx1.load('glBindBuffer'))
+        is_buffer = ctypes.CFUNCTYPE(ctypes.c_ubyte, ctypes.c_uint)(ctx1.load('glIsBuffer'))
+
+        buffer = ctypes.c_uint()
+        with ctx1:
+            gen_buffers(1, ctypes.byref(buffer))
+            bind_buffer(0x8892, buffer.value)
+        with ctx2:
+            self.assertTrue(is_buffer(buffer.value))
+
+        with self.assertRaises(TypeError):
+            device.create_context(share=object())
+
+        ctx2.release()
+        ctx1.release()
+
+    def test_nested_enter(self):
+        """Leaving a nested with block restores the outer context"""
+        device = headless.device(0)
+        ctx1 = device.create_context(glversion=330)
+        ctx2 = device.create_context(glversion=330)
+
+        before = current_context()
+        with ctx1:
+            outer = current_context()
+            self.assertTrue(outer)
+            with ctx2:
+                inner = current_context()
+                self.assertNotEqual(inner, outer)
+                with ctx1:
+                    self.assertEqual(current_context(), outer)
+                self.assertEqual(current_context(), inner)
+            self.assertEqual(current_context(), outer)
+        self.assertEqual(current_context(), before)
+
+        ctx2.release()
+        ctx1.release()
+
+    def test_enter_failure(self):
+        """A failed enter raises and keeps the current binding"""
+        device = headless.device(0)
+        ctx1 = device.create_context(glversion=330)
+        ctx2 = device.create_context(glversion=330)
+        ctx2.release()
+
+        with ctx1:
+            outer = current_context()
+            with self.assertRaises(Exception):
+                with ctx2:
+                    pass
+            self.assertEqual(current_context(), outer)
+
+        # a context current on another thread cannot be made current here
+        entered = threading.Event()
+        done = threading.Event()
+
+        def worker():
+            with ctx1:
+                entered.set()
+                done.wait()
+
+        thread = threading.Thread(target=worker)
+        thread.start()
+        entered.wait()
+        try:
+            before = current_context()
+            with self.assertRaises(Exception):
+                with ctx1:
+                    pass
+            self.assertEqual(current_context(), before)
+        finally:
+            done.set()
+            thread.join()
+        ctx1.release()
+
+    def test_init(self):
+        """init() replaces and destroys the context of a previous call"""
+        device = headless.device(0)
+        headless.init(0)
+        first = current_context()
+        self.assertTrue(first)
+        self.assertTrue(headless.load_opengl_function('glGetString'))
+        refcount = sys.getrefcount(device)
+
+        # the previous context drops its device reference when it is destroyed
+        headless.init(0)
+        self.assertTrue(current_context())
+        self.assertEqual(sys.getrefcount(device), refcount)